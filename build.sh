@@ -1,11 +1,35 @@
 #!/bin/bash
 # Build Script
+# Usage: build.sh [win32|linux] [test]
+
+platform=${1:-win32}
+test=$2
 
-compile_flags='-static -lgdi32 -static-libgcc -static-libstdc++ -lwinmm'
 warnings='-Wall -Wno-unused-parameter'
-external='-mwindows -D EXTERNAL_BUILD'
 performant='-O3 -D FAST_BUILD'
-program_path='-o snow.exe win32_snow.cpp'
 
 echo -e "Compiling Program..."
-x86_64-w64-mingw32-g++ $program_path $compile_flags $performant $external $warnings
+if [ "$platform" == "linux" ]; then
+  external='-D EXTERNAL_BUILD'
+
+  # Simulation is a library the platform reloads when it changes, renamed
+  # into place so it is never loaded half written
+  g++ -shared -fPIC -o libsnow.so.tmp snow.cpp $performant $external $warnings &&
+    mv libsnow.so.tmp libsnow.so
+
+  compile_flags='-lX11 -lXext -lpthread -lrt -ldl'
+  program_path='-o snow linux_snow.cpp'
+  g++ $program_path $compile_flags $performant $external $warnings
+
+  g++ -o snowstat linux_snowstat.cpp -lrt $performant $external $warnings
+
+  # Incremental and band split rendering must match full frame renders
+  if [ "$test" == "test" ]; then
+    ./snow --selftest || exit 1
+  fi
+else
+  compile_flags='-static -lgdi32 -ladvapi32 -static-libgcc -static-libstdc++ -lwinmm'
+  external='-mwindows -D EXTERNAL_BUILD'
+  program_path='-o snow.exe win32_snow.cpp'
+  x86_64-w64-mingw32-g++ $program_path $compile_flags $performant $external $warnings
+fi
@@ -0,0 +1,1649 @@
+/*
+ * Filename: linux_snow.cpp
+ * Author: Kevin Hine
+ * Description: Linux System Layer, X11 with MIT-SHM presentation
+ * Date: Oct 18 2026
+ */
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/shm.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "snow.h"
+
+// Render into one while the server reads the other
+#define LINUX_PRESENT_BUFFER_COUNT 2
+
+#define LINUX_HUGE_PAGE_SIZE Megabytes(2)
+
+struct linuxPresentBuffer {
+  XImage *image;
+  XShmSegmentInfo segment;
+  // Bytes backing image, kept across resizes that fit
+  size_t capacity;
+  // Frames since this image was drawn, 0 if never, see FrameBuffer::age
+  int age;
+  // XShmPutImage issued and its completion event not yet seen, the server may
+  // still be reading the segment
+  bool inFlight;
+};
+
+struct linuxPresenter {
+  Display *display;
+  Window window;
+  GC gc;
+  Visual *visual;
+  int depth;
+  PixelFormat format;
+
+  // Falls back to XPutImage when the server can't share memory (remote display)
+  bool useShm;
+  int completionEvent;
+
+  int width;
+  int height;
+  int backIndex;
+  linuxPresentBuffer buffers[LINUX_PRESENT_BUFFER_COUNT];
+};
+
+struct linuxBenchmarkResult {
+  double secondsPerFrame;
+  // -1 when perf counters are unavailable
+  int64_t tlbMisses;
+};
+
+// Power of two so indices wrap with a mask, more than UpdateAndRenderScenes
+// queues between drains
+#define LINUX_WORK_QUEUE_SIZE 256
+
+struct linuxWorkQueueEntry {
+  PlatformWorkQueueCallback *callback;
+  void *data;
+};
+
+// Pool threads each own a stats slot
+#define LINUX_MAX_THREADS STATS_MAX_THREADS
+
+struct PlatformWorkQueue;
+
+struct linuxWorkerThread {
+  PlatformWorkQueue *queue;
+  int threadIndex;
+};
+
+// Single producer, the main thread, many consumers
+struct PlatformWorkQueue {
+  uint32_t volatile completionGoal;
+  uint32_t volatile completionCount;
+  uint32_t volatile nextEntryToWrite;
+  uint32_t volatile nextEntryToRead;
+  sem_t semaphore;
+  linuxWorkQueueEntry entries[LINUX_WORK_QUEUE_SIZE];
+  linuxWorkerThread workers[LINUX_MAX_THREADS];
+};
+
+// Simulation and rendering, built next to the executable
+#define LINUX_SNOW_LIBRARY "libsnow.so"
+
+struct linuxSnowCode {
+  void *library;
+  // In-memory copy the library was loaded from, -1 if none
+  int copy;
+  // Modification time of the library when loaded
+  timespec lastWriteTime;
+  int loadCount;
+
+  UpdateAndRenderFunc *updateAndRender;
+  UpdateAndRenderScenesFunc *updateAndRenderScenes;
+  bool isValid;
+};
+
+global_variable bool globalRunning;
+global_variable bool globalShmAttachFailed;
+global_variable bool globalUseHugePages = true;
+global_variable bool globalMergeFlakes;
+
+/*
+ * Function Name: LinuxAllocate
+ * Description: Allocate zeroed memory on 2MB pages, explicit hugetlbfs pages
+ *              if reserved, otherwise transparent huge pages
+ * Parameters: size - requested bytes
+ *             allocatedSize - bytes actually mapped, needed to free
+ * Side Effects: Maps memory
+ * Error Conditions: Returns 0 if the mapping fails
+ * Return Value: 2MB aligned memory
+ */
+internal void *
+LinuxAllocate(size_t size, size_t *allocatedSize) {
+  size_t hugeSize = AlignPow2(size, LINUX_HUGE_PAGE_SIZE);
+  if(globalUseHugePages) {
+    void *result = mmap(0, hugeSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(result != MAP_FAILED) {
+      *allocatedSize = hugeSize;
+      return result;
+    }
+  }
+
+  // Transparent huge pages only back 2MB aligned ranges, so over-map and trim
+  size_t mapSize = hugeSize + LINUX_HUGE_PAGE_SIZE;
+  uint8_t *map = (uint8_t *)mmap(0, mapSize, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(map == MAP_FAILED) {
+    *allocatedSize = 0;
+    return 0;
+  }
+
+  uint8_t *result = (uint8_t *)AlignPow2((uintptr_t)map, LINUX_HUGE_PAGE_SIZE);
+  size_t head = result - map;
+  size_t tail = mapSize - head - hugeSize;
+  if(head) {
+    munmap(map, head);
+  }
+  if(tail) {
+    munmap(result + hugeSize, tail);
+  }
+
+  if(globalUseHugePages) {
+    madvise(result, hugeSize, MADV_HUGEPAGE);
+  }
+  else {
+    madvise(result, hugeSize, MADV_NOHUGEPAGE);
+  }
+  *allocatedSize = hugeSize;
+  return result;
+}
+
+/*
+ * Function Name: LinuxReserve
+ * Description: Map zeroed memory whose head is touched every frame and whose
+ *              tail is headroom that may never be used. Only the head takes
+ *              2MB pages, the tail is reserved without committing swap and
+ *              faults in 4KB pages on first touch
+ * Parameters: size - requested bytes
+ *             usedSize - bytes at the start expected to be touched
+ *             allocatedSize - bytes actually mapped, needed to free
+ * Side Effects: Maps memory
+ * Error Conditions: Returns 0 if the mapping fails
+ * Return Value: 2MB aligned memory
+ */
+internal void *
+LinuxReserve(size_t size, size_t usedSize, size_t *allocatedSize) {
+  size_t reserveSize = AlignPow2(size, LINUX_HUGE_PAGE_SIZE);
+  size_t hugeSize = AlignPow2(usedSize, LINUX_HUGE_PAGE_SIZE);
+  if(hugeSize > reserveSize) {
+    hugeSize = reserveSize;
+  }
+  size_t tailSize = reserveSize - hugeSize;
+  int tailFlags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+
+  // Reserved hugetlbfs pages first, with the tail placed right after them
+  if(globalUseHugePages) {
+    uint8_t *result = (uint8_t *)mmap(0, hugeSize, PROT_READ | PROT_WRITE,
+                                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(result != MAP_FAILED) {
+      void *tail = result + hugeSize;
+      if(tailSize) {
+        tail = mmap(tail, tailSize, PROT_READ | PROT_WRITE, tailFlags | MAP_FIXED_NOREPLACE, -1, 0);
+      }
+      if(tail == result + hugeSize) {
+        madvise(result + hugeSize, tailSize, MADV_NOHUGEPAGE);
+        *allocatedSize = reserveSize;
+        return result;
+      }
+
+      // Kernels before 4.17 treat the address as a hint
+      if(tail != MAP_FAILED) {
+        munmap(tail, tailSize);
+      }
+      munmap(result, hugeSize);
+    }
+  }
+
+  // Transparent huge pages only back 2MB aligned ranges, so over-map and trim
+  size_t mapSize = reserveSize + LINUX_HUGE_PAGE_SIZE;
+  uint8_t *map = (uint8_t *)mmap(0, mapSize, PROT_READ | PROT_WRITE, tailFlags, -1, 0);
+  if(map == MAP_FAILED) {
+    *allocatedSize = 0;
+    return 0;
+  }
+
+  uint8_t *result = (uint8_t *)AlignPow2((uintptr_t)map, LINUX_HUGE_PAGE_SIZE);
+  size_t head = result - map;
+  size_t tail = mapSize - head - reserveSize;
+  if(head) {
+    munmap(map, head);
+  }
+  if(tail) {
+    munmap(result + reserveSize, tail);
+  }
+
+  madvise(result, hugeSize, globalUseHugePages ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+  if(tailSize) {
+    madvise(result + hugeSize, tailSize, MADV_NOHUGEPAGE);
+  }
+  *allocatedSize = reserveSize;
+  return result;
+}
+
+/*
+ * Function Name: LinuxDeallocate
+ * Description: Free memory from LinuxAllocate or LinuxReserve
+ * Parameters: memory - allocation
+ *             allocatedSize - size reported by LinuxAllocate or LinuxReserve
+ * Side Effects: Unmaps memory
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+LinuxDeallocate(void *memory, size_t allocatedSize) {
+  if(memory) {
+    munmap(memory, allocatedSize);
+  }
+}
+
+/*
+ * Function Name: LinuxShmErrorHandler
+ * Description: Catches X errors raised while attaching shared memory
+ * Parameters: display - X connection
+ *             event - error details
+ * Side Effects: Flags the failed attach
+ * Error Conditions: N/A
+ * Return Value: Ignored
+ */
+internal int
+LinuxShmErrorHandler(Display *display, XErrorEvent *event) {
+  globalShmAttachFailed = true;
+  return 0;
+}
+
+/*
+ * Function Name: LinuxGetPixelFormat
+ * Description: Match a TrueColor visual to a framebuffer pixel format. Masks,
+ *              pixel size and byte order must all agree with the format
+ * Parameters: display - X connection
+ *             visual - window visual
+ *             depth - window depth
+ *             format - result
+ * Side Effects: N/A
+ * Error Conditions: Returns false for layouts no format writes, e.g. 555,
+ *                   BGR 565, palettes, or big endian servers
+ * Return Value: Success
+ */
+internal bool
+LinuxGetPixelFormat(Display *display, Visual *visual, int depth, PixelFormat *format) {
+  if(visual->c_class != TrueColor || ImageByteOrder(display) != LSBFirst) {
+    return false;
+  }
+
+  // Images of a depth use the server's pixmap format for it
+  int bitsPerPixel = 0;
+  int formatCount;
+  XPixmapFormatValues *formats = XListPixmapFormats(display, &formatCount);
+  if(formats) {
+    for(int i = 0; i < formatCount; i++) {
+      if(formats[i].depth == depth) {
+        bitsPerPixel = formats[i].bits_per_pixel;
+      }
+    }
+    XFree(formats);
+  }
+
+  if(bitsPerPixel == 32 && visual->red_mask == 0xff0000 &&
+     visual->green_mask == 0xff00 && visual->blue_mask == 0xff) {
+    *format = PixelFormat_BGRA8888;
+    return true;
+  }
+  if(bitsPerPixel == 32 && visual->red_mask == 0xff &&
+     visual->green_mask == 0xff00 && visual->blue_mask == 0xff0000) {
+    *format = PixelFormat_RGBA8888;
+    return true;
+  }
+  if(bitsPerPixel == 16 && visual->red_mask == 0xf800 &&
+     visual->green_mask == 0x7e0 && visual->blue_mask == 0x1f) {
+    *format = PixelFormat_RGB565;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Function Name: LinuxFreePresentBuffer
+ * Description: Release an image and its shared segment
+ * Parameters: presenter - presentation state
+ *             buffer - image to free
+ * Side Effects: Detaches shared memory from the server and process
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+LinuxFreePresentBuffer(linuxPresenter *presenter, linuxPresentBuffer *buffer) {
+  if(!buffer->image) {
+    return;
+  }
+
+  // Shm images don't free their data, XPutImage ones free() it
+  if(presenter->useShm) {
+    XShmDetach(presenter->display, &buffer->segment);
+    XDestroyImage(buffer->image);
+    shmdt(buffer->segment.shmaddr);
+  }
+  else {
+    XDestroyImage(buffer->image);
+  }
+  buffer->image = 0;
+  buffer->capacity = 0;
+  buffer->inFlight = false;
+}
+
+/*
+ * Function Name: LinuxFreePresentBuffers
+ * Description: Release every image and shared segment
+ * Parameters: presenter - presentation state
+ * Side Effects: Detaches shared memory from the server and process
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+LinuxFreePresentBuffers(linuxPresenter *presenter) {
+  // Segments can't go away while the server is still reading them
+  XSync(presenter->display, False);
+
+  for(int i = 0; i < LINUX_PRESENT_BUFFER_COUNT; i++) {
+    LinuxFreePresentBuffer(presenter, presenter->buffers + i);
+  }
+}
+
+/*
+ * Function Name: LinuxCreateShmSegment
+ * Description: Allocate a SysV shared memory segment the X server maps, so
+ *              presenting copies nothing client side. Prefers 2MB pages
+ * Parameters: presenter - presentation state
+ *             buffer - image whose segment to create
+ *             size - requested bytes
+ * Side Effects: Creates and attaches a shared segment
+ * Error Conditions: Returns false if the segment can't be created or
+ *                   attached by either side
+ * Return Value: Success
+ */
+internal bool
+LinuxCreateShmSegment(linuxPresenter *presenter, linuxPresentBuffer *buffer, size_t size) {
+  size_t hugeSize = AlignPow2(size, LINUX_HUGE_PAGE_SIZE);
+  buffer->segment.shmid = -1;
+  if(globalUseHugePages) {
+    buffer->segment.shmid = shmget(IPC_PRIVATE, hugeSize, IPC_CREAT | SHM_HUGETLB | 0600);
+  }
+  if(buffer->segment.shmid < 0) {
+    buffer->segment.shmid = shmget(IPC_PRIVATE, hugeSize, IPC_CREAT | 0600);
+  }
+  if(buffer->segment.shmid < 0) {
+    return false;
+  }
+
+  buffer->segment.shmaddr = (char *)shmat(buffer->segment.shmid, 0, 0);
+  if(buffer->segment.shmaddr == (char *)-1) {
+    shmctl(buffer->segment.shmid, IPC_RMID, 0);
+    buffer->segment.shmaddr = 0;
+    return false;
+  }
+  buffer->segment.readOnly = False;
+  if(globalUseHugePages) {
+    madvise(buffer->segment.shmaddr, hugeSize, MADV_HUGEPAGE);
+  }
+
+  // Attach errors arrive asynchronously, so sync while trapping them
+  globalShmAttachFailed = false;
+  XErrorHandler oldHandler = XSetErrorHandler(LinuxShmErrorHandler);
+  XShmAttach(presenter->display, &buffer->segment);
+  XSync(presenter->display, False);
+  XSetErrorHandler(oldHandler);
+
+  // Segment is destroyed once both sides detach, even if we crash
+  shmctl(buffer->segment.shmid, IPC_RMID, 0);
+
+  if(globalShmAttachFailed) {
+    shmdt(buffer->segment.shmaddr);
+    return false;
+  }
+  buffer->capacity = hugeSize;
+  return true;
+}
+
+/*
+ * Function Name: LinuxResizePresentBuffers
+ * Description: Size presentation images to the window, reusing segments that
+ *              are already large enough. Rows are padded to a cache line by
+ *              widening the image and only presenting the visible part
+ * Parameters: presenter - presentation state
+ *             width - visible width
+ *             height - visible height
+ * Side Effects: Recreates image headers, grows segments as needed
+ * Error Conditions: Drops to XPutImage if shared memory fails, returns false
+ *                   if an image can't be allocated at all
+ * Return Value: Success
+ */
+internal bool
+LinuxResizePresentBuffers(linuxPresenter *presenter, int width, int height) {
+  // Wait for the server to finish reading before touching any buffer
+  XSync(presenter->display, False);
+
+  presenter->width = width;
+  presenter->height = height;
+  presenter->backIndex = 0;
+
+  int pixelBytes = GetPixelFormatBytes(presenter->format);
+  int pitch = AlignPow2(width * pixelBytes, FRAMEBUFFER_ROW_ALIGNMENT);
+  int imageWidth = pitch / pixelBytes;
+  size_t size = (size_t)pitch * height;
+
+  for(int i = 0; i < LINUX_PRESENT_BUFFER_COUNT; i++) {
+    linuxPresentBuffer *buffer = presenter->buffers + i;
+    buffer->inFlight = false;
+    buffer->age = 0;
+
+    if(presenter->useShm) {
+      if(buffer->image && buffer->capacity >= size) {
+        // Only the header changes, the attached segment is kept
+        XDestroyImage(buffer->image);
+        buffer->image = 0;
+      }
+      else {
+        LinuxFreePresentBuffer(presenter, buffer);
+        if(!LinuxCreateShmSegment(presenter, buffer, size)) {
+          DEBUGPRINT("MIT-SHM attach failed, falling back to XPutImage\n");
+          LinuxFreePresentBuffers(presenter);
+          presenter->useShm = false;
+          i = -1;
+          continue;
+        }
+      }
+
+      buffer->image = XShmCreateImage(presenter->display, presenter->visual, presenter->depth,
+                                      ZPixmap, buffer->segment.shmaddr, &buffer->segment,
+                                      imageWidth, height);
+    }
+    else {
+      // XDestroyImage frees data with free()
+      LinuxFreePresentBuffer(presenter, buffer);
+      char *data = (char *)aligned_alloc(FRAMEBUFFER_ROW_ALIGNMENT, size);
+      if(!data) {
+        return false;
+      }
+      memset(data, 0, size);
+      buffer->image = XCreateImage(presenter->display, presenter->visual, presenter->depth,
+                                   ZPixmap, 0, data, imageWidth, height, pixelBytes * 8, pitch);
+      if(!buffer->image) {
+        free(data);
+      }
+      buffer->capacity = size;
+    }
+
+    // The renderer writes rows of pitch bytes, any other image layout would
+    // be overrun
+    if(!buffer->image || buffer->image->bytes_per_line != pitch ||
+       buffer->image->bits_per_pixel != pixelBytes * 8) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Function Name: LinuxProcessEvent
+ * Description: Handle one X event
+ * Parameters: presenter - presentation state
+ *             event - X event
+ *             wmDeleteWindow - close request atom
+ * Side Effects: Marks buffers free, resizes, or stops the program
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+LinuxProcessEvent(linuxPresenter *presenter, XEvent *event, Atom wmDeleteWindow) {
+  if(presenter->useShm && event->type == presenter->completionEvent) {
+    XShmCompletionEvent *completion = (XShmCompletionEvent *)event;
+    for(int i = 0; i < LINUX_PRESENT_BUFFER_COUNT; i++) {
+      linuxPresentBuffer *buffer = presenter->buffers + i;
+      if(buffer->image && buffer->segment.shmseg == completion->shmseg) {
+        buffer->inFlight = false;
+      }
+    }
+    return;
+  }
+
+  switch(event->type) {
+    case ConfigureNotify: {
+      XConfigureEvent *configure = &event->xconfigure;
+      if(configure->width != presenter->width || configure->height != presenter->height) {
+        if(!LinuxResizePresentBuffers(presenter, configure->width, configure->height)) {
+          fprintf(stderr, "Unable to allocate %dx%d images\n", configure->width, configure->height);
+          globalRunning = false;
+        }
+      }
+    } break;
+
+    case ClientMessage: {
+      if((Atom)event->xclient.data.l[0] == wmDeleteWindow) {
+        globalRunning = false;
+      }
+    } break;
+
+    case DestroyNotify: {
+      globalRunning = false;
+    } break;
+  }
+}
+
+/*
+ * Function Name: LinuxAcquireBackBuffer
+ * Description: Wait for the server to finish reading the next buffer
+ * Parameters: presenter - presentation state
+ *             wmDeleteWindow - close request atom
+ * Side Effects: Processes X events while blocked
+ * Error Conditions: N/A
+ * Return Value: Buffer safe to render into
+ */
+internal linuxPresentBuffer *
+LinuxAcquireBackBuffer(linuxPresenter *presenter, Atom wmDeleteWindow) {
+  linuxPresentBuffer *result = presenter->buffers + presenter->backIndex;
+  while(result->inFlight && globalRunning) {
+    XEvent event;
+    XNextEvent(presenter->display, &event);
+    LinuxProcessEvent(presenter, &event, wmDeleteWindow);
+
+    // Resizing replaces the buffers
+    result = presenter->buffers + presenter->backIndex;
+  }
+  return result;
+}
+
+/*
+ * Function Name: LinuxPresent
+ * Description: Show the back buffer and flip to the other one
+ * Parameters: presenter - presentation state
+ * Side Effects: Queues the image on the server
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+LinuxPresent(linuxPresenter *presenter) {
+  linuxPresentBuffer *back = presenter->buffers + presenter->backIndex;
+
+  // The background clear touches every pixel, so the whole frame is sent
+  if(presenter->useShm) {
+    XShmPutImage(presenter->display, presenter->window, presenter->gc, back->image,
+                 0, 0, 0, 0, presenter->width, presenter->height, True);
+    back->inFlight = true;
+  }
+  else {
+    XPutImage(presenter->display, presenter->window, presenter->gc, back->image,
+              0, 0, 0, 0, presenter->width, presenter->height);
+  }
+  XFlush(presenter->display);
+
+  for(int i = 0; i < LINUX_PRESENT_BUFFER_COUNT; i++) {
+    if(presenter->buffers[i].age) {
+      presenter->buffers[i].age++;
+    }
+  }
+  back->age = 1;
+  presenter->backIndex = (presenter->backIndex + 1) % LINUX_PRESENT_BUFFER_COUNT;
+}
+
+/*
+ * Function Name: LinuxGetWallClock
+ * Description: Clock system time
+ * Parameters: N/A
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Monotonic time stamp
+ */
+inline timespec
+LinuxGetWallClock() {
+  timespec result;
+  clock_gettime(CLOCK_MONOTONIC, &result);
+  return result;
+}
+
+/*
+ * Function Name: LinuxGetSecondsElapsed
+ * Description: Convert time stamps to wall clock duration
+ * Parameters: start - sample start
+ *             end - sample end
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Seconds elapsed
+ */
+inline double
+LinuxGetSecondsElapsed(timespec start, timespec end) {
+  double result = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) * 1e-9;
+  return result;
+}
+
+/*
+ * Function Name: LinuxGetNanoseconds
+ * Description: Monotonic clock for stats timers
+ * Parameters: N/A
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Nanoseconds since an arbitrary start
+ */
+internal uint64_t
+LinuxGetNanoseconds() {
+  timespec now = LinuxGetWallClock();
+  uint64_t result = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  return result;
+}
+
+/*
+ * Function Name: LinuxOpenStats
+ * Description: Create the shared memory object monitors read counters from
+ * Parameters: name - POSIX shared memory name, e.g. /snow.1234
+ * Side Effects: Replaces a stale object of the same name
+ * Error Conditions: Returns 0 if shared memory is unavailable or the name
+ *                   stays taken
+ * Return Value: Zeroed stats with a filled in header
+ */
+internal Stats *
+LinuxOpenStats(const char *name) {
+  // Never open an object someone else created. One left by a run that died
+  // before unlinking it is removed and created afresh, once
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if(fd < 0 && errno == EEXIST && shm_unlink(name) == 0) {
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  }
+  if(fd < 0) {
+    fprintf(stderr, "Unable to create stats %s: %s\n", name, strerror(errno));
+    return 0;
+  }
+
+  Stats *result = 0;
+  if(ftruncate(fd, sizeof(Stats)) == 0) {
+    void *mapped = mmap(0, sizeof(Stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mapped != MAP_FAILED) {
+      result = (Stats *)mapped;
+      result->version = STATS_VERSION;
+      result->size = sizeof(Stats);
+      result->pid = getpid();
+      // Readers check the magic, so it goes last
+      __atomic_store_n(&result->magic, STATS_MAGIC, __ATOMIC_RELEASE);
+    }
+  }
+  close(fd);
+
+  if(!result) {
+    shm_unlink(name);
+  }
+  return result;
+}
+
+/*
+ * Function Name: LinuxCloseStats
+ * Description: Unmap and remove the stats object
+ * Parameters: stats - LinuxOpenStats result, may be 0
+ *             name - POSIX shared memory name
+ * Side Effects: Monitors still attached keep their mapping
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+LinuxCloseStats(Stats *stats, const char *name) {
+  if(stats) {
+    munmap(stats, sizeof(Stats));
+    shm_unlink(name);
+  }
+}
+
+/*
+ * Function Name: LinuxOpenTLBCounter
+ * Description: Open a user space data TLB miss counter for this thread
+ * Parameters: op - PERF_COUNT_HW_CACHE_OP_READ or _WRITE
+ * Side Effects: N/A
+ * Error Conditions: Returns -1 without perf access or hardware support
+ * Return Value: Counter file descriptor, disabled
+ */
+internal int
+LinuxOpenTLBCounter(uint64_t op) {
+  perf_event_attr attr = {};
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_DTLB | (op << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  int result = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  return result;
+}
+
+/*
+ * Function Name: LinuxGetLibraryPath
+ * Description: Path of the simulation library beside the executable
+ * Parameters: path - result
+ *             size - path capacity
+ * Side Effects: N/A
+ * Error Conditions: Falls back to the working directory
+ * Return Value: N/A
+ */
+internal void
+LinuxGetLibraryPath(char *path, size_t size) {
+  ssize_t length = readlink("/proc/self/exe", path, size - 1);
+  if(length > 0) {
+    path[length] = 0;
+    char *slash = strrchr(path, '/');
+    if(slash && (size_t)(slash + 1 - path) + sizeof(LINUX_SNOW_LIBRARY) <= size) {
+      memcpy(slash + 1, LINUX_SNOW_LIBRARY, sizeof(LINUX_SNOW_LIBRARY));
+      return;
+    }
+  }
+  snprintf(path, size, "./%s", LINUX_SNOW_LIBRARY);
+}
+
+/*
+ * Function Name: LinuxGetLastWriteTime
+ * Description: Modification time of a file
+ * Parameters: path - file path
+ * Side Effects: N/A
+ * Error Conditions: Zero if the file is missing
+ * Return Value: Result
+ */
+internal timespec
+LinuxGetLastWriteTime(const char *path) {
+  timespec result = {};
+  struct stat info;
+  if(stat(path, &info) == 0) {
+    result = info.st_mtim;
+  }
+  return result;
+}
+
+/*
+ * Function Name: LinuxCopyFile
+ * Description: Copy a file's contents into an open file
+ * Parameters: source - path to read
+ *             dest - descriptor to write, at its start
+ * Side Effects: Advances dest's offset
+ * Error Conditions: N/A
+ * Return Value: True on success
+ */
+internal bool
+LinuxCopyFile(const char *source, int dest) {
+  int in = open(source, O_RDONLY);
+  if(in < 0) {
+    return false;
+  }
+
+  bool result = true;
+  char chunk[Kilobytes(64)];
+  ssize_t bytes;
+  while((bytes = read(in, chunk, sizeof(chunk))) > 0) {
+    if(write(dest, chunk, bytes) != bytes) {
+      result = false;
+      break;
+    }
+  }
+  result = result && (bytes == 0);
+
+  close(in);
+  return result;
+}
+
+/*
+ * Function Name: LinuxLoadSnowCode
+ * Description: Load the simulation library from a private in-memory copy,
+ *              so the build can replace the original while it is loaded and
+ *              no other user can swap the copy before dlopen reads it. The
+ *              copy stays open while loaded, so each load has a new
+ *              /proc/self/fd name and dlopen can't hand back the previous one
+ * Parameters: sourcePath - library path
+ *             loadCount - loads so far
+ * Side Effects: Maps the library
+ * Error Conditions: isValid is false if the library is missing, incomplete
+ *                   or lacks the services
+ * Return Value: Loaded code
+ */
+internal linuxSnowCode
+LinuxLoadSnowCode(const char *sourcePath, int loadCount) {
+  linuxSnowCode result = {};
+  result.lastWriteTime = LinuxGetLastWriteTime(sourcePath);
+  result.loadCount = loadCount + 1;
+
+  result.copy = memfd_create("libsnow.so", MFD_CLOEXEC);
+  if(result.copy >= 0 && LinuxCopyFile(sourcePath, result.copy)) {
+    char copyPath[64];
+    snprintf(copyPath, sizeof(copyPath), "/proc/self/fd/%d", result.copy);
+    result.library = dlopen(copyPath, RTLD_NOW | RTLD_LOCAL);
+  }
+
+  if(result.library) {
+    result.updateAndRender = (UpdateAndRenderFunc *)dlsym(result.library, "UpdateAndRender");
+    result.updateAndRenderScenes = (UpdateAndRenderScenesFunc *)dlsym(result.library, "UpdateAndRenderScenes");
+    result.isValid = result.updateAndRender && result.updateAndRenderScenes;
+  }
+  else {
+    DEBUGPRINT("Unable to load %s: %s\n", sourcePath, dlerror());
+  }
+
+  if(!result.isValid) {
+    if(result.library) {
+      dlclose(result.library);
+      result.library = 0;
+    }
+    if(result.copy >= 0) {
+      close(result.copy);
+    }
+    result.copy = -1;
+  }
+  return result;
+}
+
+/*
+ * Function Name: LinuxUnloadSnowCode
+ * Description: Release a loaded simulation library
+ * Parameters: code - loaded code
+ * Side Effects: Services may no longer be called
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+LinuxUnloadSnowCode(linuxSnowCode *code) {
+  if(code->library) {
+    dlclose(code->library);
+  }
+  if(code->copy >= 0) {
+    close(code->copy);
+  }
+  code->library = 0;
+  code->copy = -1;
+  code->updateAndRender = 0;
+  code->updateAndRenderScenes = 0;
+  code->isValid = false;
+}
+
+/*
+ * Function Name: LinuxReloadSnowCodeIfChanged
+ * Description: Swap in the simulation library when it is rebuilt. Memory
+ *              is untouched, so scenes keep running in the new code
+ * Parameters: code - loaded code
+ *             sourcePath - library path
+ * Side Effects: Unloads the previous library once the new one loads
+ * Error Conditions: Keeps the previous library if the new one fails to load
+ * Return Value: N/A
+ */
+internal void
+LinuxReloadSnowCodeIfChanged(linuxSnowCode *code, const char *sourcePath) {
+  timespec writeTime = LinuxGetLastWriteTime(sourcePath);
+  if(writeTime.tv_sec == code->lastWriteTime.tv_sec && writeTime.tv_nsec == code->lastWriteTime.tv_nsec) {
+    return;
+  }
+
+  linuxSnowCode reloaded = LinuxLoadSnowCode(sourcePath, code->loadCount);
+  if(reloaded.isValid) {
+    LinuxUnloadSnowCode(code);
+    *code = reloaded;
+    DEBUGPRINT("Reloaded %s\n", sourcePath);
+  }
+  else {
+    // Try again on the next write rather than every frame
+    code->lastWriteTime = writeTime;
+    code->loadCount = reloaded.loadCount;
+  }
+}
+
+/*
+ * Function Name: LinuxRunBenchmark
+ * Description: Render frames offscreen, timing them and counting TLB misses
+ * Parameters: code - loaded simulation
+ *             frameCount - frames to render
+ *             width - framebuffer width
+ *             height - framebuffer height
+ * Side Effects: Allocates and frees Memory and a framebuffer with the current
+ *               huge page setting
+ * Error Conditions: N/A
+ * Return Value: Per frame time and total misses
+ */
+internal linuxBenchmarkResult
+LinuxRunBenchmark(linuxSnowCode *code, int frameCount, int width, int height) {
+  linuxBenchmarkResult result = {};
+
+  Memory memory = {};
+  size_t memorySize;
+  memory.size = SNOW_MEMORY_SIZE;
+  memory.storage = LinuxReserve(memory.size, sizeof(State), &memorySize);
+  SetDefaultObstacles(&memory);
+  memory.mergeFlakes = globalMergeFlakes;
+
+  FrameBuffer buffer = {};
+  size_t bitmapSize;
+  buffer.width = width;
+  buffer.height = height;
+  buffer.format = PixelFormat_BGRA8888;
+  buffer.pixelBytes = GetPixelFormatBytes(buffer.format);
+  buffer.pitch = AlignPow2(width * buffer.pixelBytes, FRAMEBUFFER_ROW_ALIGNMENT);
+  buffer.bitmap = LinuxAllocate((size_t)buffer.pitch * height, &bitmapSize);
+  Assert(memory.storage && buffer.bitmap);
+
+  // Fault pages in and let the particle count settle before measuring
+  double secondsElapsed = 1.0f / 60.0f;
+  for(int i = 0; i < 120; i++) {
+    code->updateAndRender(&memory, &buffer, secondsElapsed);
+    buffer.age = 1;
+  }
+
+  int counters[2] = {
+    LinuxOpenTLBCounter(PERF_COUNT_HW_CACHE_OP_READ),
+    LinuxOpenTLBCounter(PERF_COUNT_HW_CACHE_OP_WRITE),
+  };
+  for(size_t i = 0; i < ArrayLength(counters); i++) {
+    if(counters[i] >= 0) {
+      ioctl(counters[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  timespec start = LinuxGetWallClock();
+  for(int i = 0; i < frameCount; i++) {
+    code->updateAndRender(&memory, &buffer, secondsElapsed);
+  }
+  timespec end = LinuxGetWallClock();
+
+  result.tlbMisses = -1;
+  for(size_t i = 0; i < ArrayLength(counters); i++) {
+    if(counters[i] >= 0) {
+      ioctl(counters[i], PERF_EVENT_IOC_DISABLE, 0);
+      uint64_t misses = 0;
+      if(read(counters[i], &misses, sizeof(misses)) == sizeof(misses)) {
+        result.tlbMisses = (result.tlbMisses < 0) ? misses : result.tlbMisses + misses;
+      }
+      close(counters[i]);
+    }
+  }
+  result.secondsPerFrame = LinuxGetSecondsElapsed(start, end) / frameCount;
+
+  LinuxDeallocate(buffer.bitmap, bitmapSize);
+  LinuxDeallocate(memory.storage, memorySize);
+  return result;
+}
+
+/*
+ * Function Name: LinuxAddEntry
+ * Description: Queue work for the pool, called only from the main thread
+ * Parameters: queue - work queue
+ *             callback - entry point
+ *             data - entry argument
+ * Side Effects: Wakes a worker
+ * Error Conditions: Asserts if the queue is full
+ * Return Value: N/A
+ */
+internal void
+LinuxAddEntry(PlatformWorkQueue *queue, PlatformWorkQueueCallback *callback, void *data) {
+  uint32_t write = queue->nextEntryToWrite;
+  uint32_t nextWrite = (write + 1) & (LINUX_WORK_QUEUE_SIZE - 1);
+  Assert(nextWrite != __atomic_load_n(&queue->nextEntryToRead, __ATOMIC_ACQUIRE));
+
+  linuxWorkQueueEntry *entry = queue->entries + write;
+  entry->callback = callback;
+  entry->data = data;
+  queue->completionGoal++;
+
+  // Publish the entry before workers can see the new write index
+  __atomic_store_n(&queue->nextEntryToWrite, nextWrite, __ATOMIC_RELEASE);
+  sem_post(&queue->semaphore);
+}
+
+/*
+ * Function Name: LinuxDoNextWorkQueueEntry
+ * Description: Claim and run one queued entry, if any
+ * Parameters: queue - work queue
+ *             threadIndex - pool thread calling
+ * Side Effects: Runs the entry's callback
+ * Error Conditions: N/A
+ * Return Value: True if the queue was empty and the caller may sleep
+ */
+internal bool
+LinuxDoNextWorkQueueEntry(PlatformWorkQueue *queue, int threadIndex) {
+  uint32_t read = __atomic_load_n(&queue->nextEntryToRead, __ATOMIC_ACQUIRE);
+  if(read == __atomic_load_n(&queue->nextEntryToWrite, __ATOMIC_ACQUIRE)) {
+    return true;
+  }
+
+  uint32_t nextRead = (read + 1) & (LINUX_WORK_QUEUE_SIZE - 1);
+  if(__atomic_compare_exchange_n(&queue->nextEntryToRead, &read, nextRead, false,
+                                 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    linuxWorkQueueEntry entry = queue->entries[read];
+    entry.callback(queue, entry.data, threadIndex);
+    __atomic_add_fetch(&queue->completionCount, 1, __ATOMIC_RELEASE);
+  }
+  return false;
+}
+
+/*
+ * Function Name: LinuxCompleteAllWork
+ * Description: Help run queued entries until all of them have finished
+ * Parameters: queue - work queue
+ * Side Effects: Resets the completion counts
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+LinuxCompleteAllWork(PlatformWorkQueue *queue) {
+  while(queue->completionGoal != __atomic_load_n(&queue->completionCount, __ATOMIC_ACQUIRE)) {
+    LinuxDoNextWorkQueueEntry(queue, 0);
+  }
+  queue->completionGoal = 0;
+  queue->completionCount = 0;
+}
+
+/*
+ * Function Name: LinuxWorkerThreadProc
+ * Description: Worker entry point, runs queued entries and sleeps when idle
+ * Parameters: param - linuxWorkerThread
+ * Side Effects: Runs forever
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void *
+LinuxWorkerThreadProc(void *param) {
+  linuxWorkerThread *worker = (linuxWorkerThread *)param;
+  PlatformWorkQueue *queue = worker->queue;
+  for(;;) {
+    if(LinuxDoNextWorkQueueEntry(queue, worker->threadIndex)) {
+      sem_wait(&queue->semaphore);
+    }
+  }
+  return 0;
+}
+
+/*
+ * Function Name: LinuxMakeWorkQueue
+ * Description: Start worker threads for a queue, the main thread makes up
+ *              the last thread of the pool while it completes work
+ * Parameters: queue - work queue
+ *             work - filled in with the pool's services
+ *             threadCount - pool size including the main thread
+ * Side Effects: Spawns threadCount - 1 detached threads
+ * Error Conditions: Pool is smaller if thread creation fails, and at most
+ *                   LINUX_MAX_THREADS
+ * Return Value: N/A
+ */
+internal void
+LinuxMakeWorkQueue(PlatformWorkQueue *queue, PlatformWork *work, int threadCount) {
+  memset(queue, 0, sizeof(*queue));
+  sem_init(&queue->semaphore, 0, 0);
+
+  work->queue = queue;
+  work->threadCount = 1;
+  work->addEntry = LinuxAddEntry;
+  work->completeAllWork = LinuxCompleteAllWork;
+  if(threadCount > LINUX_MAX_THREADS) {
+    threadCount = LINUX_MAX_THREADS;
+  }
+  for(int i = 1; i < threadCount; i++) {
+    linuxWorkerThread *worker = queue->workers + i;
+    worker->queue = queue;
+    worker->threadIndex = i;
+
+    pthread_t thread;
+    if(pthread_create(&thread, 0, LinuxWorkerThreadProc, worker) != 0) {
+      break;
+    }
+    pthread_detach(thread);
+    work->threadCount++;
+  }
+}
+
+/*
+ * Function Name: LinuxRunBatch
+ * Description: Render many scenes of mixed sizes and seeds offscreen, on one
+ *              thread and then on a pool, and report throughput
+ * Parameters: code - loaded simulation
+ *             frameCount - frames to render
+ *             sceneCount - scene count
+ *             stats - shared counters, may be 0
+ * Side Effects: Allocates and frees each scene, starts the worker threads
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+LinuxRunBatch(linuxSnowCode *code, int frameCount, int sceneCount, Stats *stats) {
+  // Mix of display sizes, from signage panels to 4K walls
+  int sizes[][2] = {
+    {320, 240}, {640, 360}, {800, 480}, {1280, 720}, {1920, 1080}, {3840, 2160},
+  };
+
+  Scene *scenes = (Scene *)calloc(sceneCount, sizeof(Scene));
+  size_t *memorySizes = (size_t *)calloc(sceneCount, sizeof(size_t));
+  size_t *bitmapSizes = (size_t *)calloc(sceneCount, sizeof(size_t));
+  Assert(scenes && memorySizes && bitmapSizes);
+
+  int64_t framePixels = 0;
+  for(int i = 0; i < sceneCount; i++) {
+    Scene *scene = scenes + i;
+    scene->seed = i + 1;
+    scene->memory.size = SNOW_MEMORY_SIZE;
+    scene->memory.storage = LinuxReserve(scene->memory.size, sizeof(State), memorySizes + i);
+    scene->memory.stats = stats;
+    scene->memory.getNanoseconds = LinuxGetNanoseconds;
+    SetDefaultObstacles(&scene->memory);
+    scene->memory.mergeFlakes = globalMergeFlakes;
+
+    FrameBuffer *buffer = &scene->buffer;
+    buffer->width = sizes[i % ArrayLength(sizes)][0];
+    buffer->height = sizes[i % ArrayLength(sizes)][1];
+    buffer->format = PixelFormat_BGRA8888;
+    buffer->pixelBytes = GetPixelFormatBytes(buffer->format);
+    buffer->pitch = AlignPow2(buffer->width * buffer->pixelBytes, FRAMEBUFFER_ROW_ALIGNMENT);
+    buffer->bitmap = LinuxAllocate((size_t)buffer->pitch * buffer->height, bitmapSizes + i);
+    Assert(scene->memory.storage && buffer->bitmap);
+    framePixels += (int64_t)buffer->width * buffer->height;
+  }
+
+  local_persist PlatformWorkQueue queue;
+  PlatformWork work = {};
+  LinuxMakeWorkQueue(&queue, &work, (int)sysconf(_SC_NPROCESSORS_ONLN));
+
+  printf("%d scenes, %.1f Mpixels per frame, %d frames\n",
+         sceneCount, framePixels / 1e6, frameCount);
+  double secondsElapsed = 1.0f / 60.0f;
+  for(int pass = 0; pass < 2; pass++) {
+    PlatformWork *passWork = pass ? &work : 0;
+    timespec start = LinuxGetWallClock();
+    for(int frame = 0; frame < frameCount; frame++) {
+      code->updateAndRenderScenes(scenes, sceneCount, secondsElapsed, passWork);
+      for(int i = 0; i < sceneCount; i++) {
+        scenes[i].buffer.age = 1;
+      }
+    }
+    double seconds = LinuxGetSecondsElapsed(start, LinuxGetWallClock());
+    printf("%2d threads: %8.3f ms/frame, %8.1f Mpixels/s\n", pass ? work.threadCount : 1,
+           seconds * 1000.0f / frameCount, framePixels * frameCount / seconds / 1e6);
+  }
+
+  for(int i = 0; i < sceneCount; i++) {
+    LinuxDeallocate(scenes[i].buffer.bitmap, bitmapSizes[i]);
+    LinuxDeallocate(scenes[i].memory.storage, memorySizes[i]);
+  }
+  free(bitmapSizes);
+  free(memorySizes);
+  free(scenes);
+}
+
+struct linuxTestScene {
+  Scene scene;
+  size_t memorySize;
+  size_t bitmapSize;
+};
+
+/*
+ * Function Name: LinuxMakeTestScene
+ * Description: Allocate a scene for the self-test, with the default obstacles
+ *              and one inside the snowpack band
+ * Parameters: test - scene to fill in
+ *             width - framebuffer width
+ *             height - framebuffer height
+ *             format - framebuffer pixel format
+ *             mergeFlakes - whether touching flakes combine
+ * Side Effects: Allocates memory and bitmap
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+LinuxMakeTestScene(linuxTestScene *test, int width, int height, PixelFormat format, bool mergeFlakes) {
+  *test = {};
+  Memory *memory = &test->scene.memory;
+  memory->size = SNOW_MEMORY_SIZE;
+  memory->storage = LinuxReserve(memory->size, sizeof(State), &test->memorySize);
+  SetDefaultObstacles(memory);
+  memory->obstacles[memory->obstacleCount++] = {0.4f, 0.93f, 0.6f, 0.97f};
+  memory->mergeFlakes = mergeFlakes;
+
+  FrameBuffer *buffer = &test->scene.buffer;
+  buffer->width = width;
+  buffer->height = height;
+  buffer->format = format;
+  buffer->pixelBytes = GetPixelFormatBytes(format);
+  buffer->pitch = AlignPow2(width * buffer->pixelBytes, FRAMEBUFFER_ROW_ALIGNMENT);
+  buffer->bitmap = LinuxAllocate((size_t)buffer->pitch * height, &test->bitmapSize);
+  Assert(memory->storage && buffer->bitmap);
+}
+
+/*
+ * Function Name: LinuxFreeTestScene
+ * Description: Free a scene from LinuxMakeTestScene
+ * Parameters: test - scene
+ * Side Effects: Unmaps memory and bitmap
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+LinuxFreeTestScene(linuxTestScene *test) {
+  LinuxDeallocate(test->scene.buffer.bitmap, test->bitmapSize);
+  LinuxDeallocate(test->scene.memory.storage, test->memorySize);
+}
+
+/*
+ * Function Name: LinuxFramesMatch
+ * Description: Compare the visible pixels of two framebuffers of one size
+ * Parameters: a - framebuffer
+ *             b - framebuffer
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Whether every row matches, row padding is ignored
+ */
+internal bool
+LinuxFramesMatch(FrameBuffer *a, FrameBuffer *b) {
+  for(int y = 0; y < a->height; y++) {
+    uint8_t *rowA = (uint8_t *)a->bitmap + (size_t)y * a->pitch;
+    uint8_t *rowB = (uint8_t *)b->bitmap + (size_t)y * b->pitch;
+    if(memcmp(rowA, rowB, (size_t)a->width * a->pixelBytes) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Function Name: LinuxTestIncrementalRedraw
+ * Description: Render one simulation into a rotation of buffers of varying
+ *              age, as a presenter would, and compare every frame to a twin
+ *              simulation redrawn in full
+ * Parameters: code - loaded simulation
+ *             format - framebuffer pixel format
+ *             bufferCount - buffers rotated through, at most 4
+ *             mergeFlakes - whether touching flakes combine
+ * Side Effects: Allocates and frees the scenes
+ * Error Conditions: N/A
+ * Return Value: Frames that differed
+ */
+internal int
+LinuxTestIncrementalRedraw(linuxSnowCode *code, PixelFormat format, int bufferCount,
+                           bool mergeFlakes) {
+  int width = 320;
+  int height = 200;
+  linuxTestScene full;
+  LinuxMakeTestScene(&full, width, height, format, mergeFlakes);
+  linuxTestScene incremental[4];
+  for(int i = 0; i < bufferCount; i++) {
+    LinuxMakeTestScene(incremental + i, width, height, format, mergeFlakes);
+  }
+  // Buffers share the first scene's simulation
+  Memory *memory = &incremental[0].scene.memory;
+
+  int ages[4] = {};
+  uint32_t pick = 1;
+  int mismatches = 0;
+  double secondsElapsed = 1.0f / 60.0f;
+  for(int frame = 0; frame < 600; frame++) {
+    // Moving an obstacle dirties columns the pack alone would not
+    if(frame == 300) {
+      Obstacle moved = {0.1f, 0.9f, 0.3f, 0.95f};
+      full.scene.memory.obstacles[3] = moved;
+      memory->obstacles[3] = moved;
+    }
+
+    // Presenters hand back buffers out of order and drop their contents
+    pick = pick * 1664525 + 1013904223;
+    int k = (pick >> 16) % bufferCount;
+    if((pick >> 8) % 97 == 0) {
+      ages[k] = 0;
+    }
+
+    FrameBuffer *buffer = &incremental[k].scene.buffer;
+    buffer->age = ages[k];
+    code->updateAndRender(memory, buffer, secondsElapsed);
+    full.scene.buffer.age = 0;
+    code->updateAndRender(&full.scene.memory, &full.scene.buffer, secondsElapsed);
+    for(int i = 0; i < bufferCount; i++) {
+      if(ages[i]) {
+        ages[i]++;
+      }
+    }
+    ages[k] = 1;
+
+    if(!LinuxFramesMatch(&full.scene.buffer, buffer)) {
+      mismatches++;
+    }
+  }
+
+  LinuxFreeTestScene(&full);
+  for(int i = 0; i < bufferCount; i++) {
+    LinuxFreeTestScene(incremental + i);
+  }
+  return mismatches;
+}
+
+/*
+ * Function Name: LinuxTestBandSplit
+ * Description: Render a batch of scenes whose large frames are split into
+ *              bands on a pool, and compare every frame to the same scenes
+ *              rendered whole one at a time
+ * Parameters: code - loaded simulation
+ *             work - thread pool
+ * Side Effects: Allocates and frees the scenes
+ * Error Conditions: N/A
+ * Return Value: Scene frames that differed
+ */
+internal int
+LinuxTestBandSplit(linuxSnowCode *code, PlatformWork *work) {
+  // Odd sizes leave uneven bands, the two largest frames are always split.
+  // Frames are small enough that flakes reach every band within the run
+  int sizes[][2] = {
+    {320, 240}, {1280, 720}, {64, 48}, {960, 540}, {100, 100}, {640, 360}, {1, 1}, {333, 777},
+  };
+  PixelFormat formats[] = {
+    PixelFormat_BGRA8888, PixelFormat_RGB565, PixelFormat_Gray8, PixelFormat_RGBA8888,
+  };
+  int const sceneCount = ArrayLength(sizes);
+
+  linuxTestScene whole[sceneCount];
+  linuxTestScene split[sceneCount];
+  Scene scenes[sceneCount];
+  for(int i = 0; i < sceneCount; i++) {
+    PixelFormat format = formats[i % ArrayLength(formats)];
+    LinuxMakeTestScene(whole + i, sizes[i][0], sizes[i][1], format, i % 2);
+    LinuxMakeTestScene(split + i, sizes[i][0], sizes[i][1], format, i % 2);
+    scenes[i] = split[i].scene;
+  }
+
+  int mismatches = 0;
+  double secondsElapsed = 1.0f / 60.0f;
+  for(int frame = 0; frame < 300; frame++) {
+    for(int i = 0; i < sceneCount; i++) {
+      code->updateAndRender(&whole[i].scene.memory, &whole[i].scene.buffer, secondsElapsed);
+      whole[i].scene.buffer.age = 1;
+    }
+    code->updateAndRenderScenes(scenes, sceneCount, secondsElapsed, work);
+    for(int i = 0; i < sceneCount; i++) {
+      scenes[i].buffer.age = 1;
+      if(!LinuxFramesMatch(&whole[i].scene.buffer, &scenes[i].buffer)) {
+        mismatches++;
+      }
+    }
+  }
+
+  for(int i = 0; i < sceneCount; i++) {
+    LinuxFreeTestScene(whole + i);
+    LinuxFreeTestScene(split + i);
+  }
+  return mismatches;
+}
+
+/*
+ * Function Name: LinuxRunSelfTest
+ * Description: Check that incremental snowpack redraws match full redraws
+ *              for any buffer age, and that band split rendering matches
+ *              whole frame rendering
+ * Parameters: code - loaded simulation
+ * Side Effects: Starts the worker threads, prints each check
+ * Error Conditions: N/A
+ * Return Value: Exit code, 0 if every check passed
+ */
+internal int
+LinuxRunSelfTest(linuxSnowCode *code) {
+  PixelFormat formats[] = {
+    PixelFormat_BGRA8888, PixelFormat_RGBA8888, PixelFormat_RGB565, PixelFormat_Gray8,
+  };
+  // One buffer is always one frame old, four are picked at random and
+  // sometimes lose their contents, so they reach every age
+  int bufferCounts[] = {1, 4};
+  int failures = 0;
+  for(int f = 0; f < (int)ArrayLength(formats); f++) {
+    for(int b = 0; b < (int)ArrayLength(bufferCounts); b++) {
+      int bufferCount = bufferCounts[b];
+      bool mergeFlakes = f % 2 == 0;
+      int mismatches = LinuxTestIncrementalRedraw(code, formats[f], bufferCount, mergeFlakes);
+      printf("incremental redraw, format %d, %d buffers: %d mismatched frames\n",
+             formats[f], bufferCount, mismatches);
+      failures += mismatches;
+    }
+  }
+
+  local_persist PlatformWorkQueue queue;
+  PlatformWork work = {};
+  // More workers than cores still runs bands of one frame concurrently
+  LinuxMakeWorkQueue(&queue, &work, 4);
+  for(int pass = 0; pass < 2; pass++) {
+    int mismatches = LinuxTestBandSplit(code, pass ? &work : 0);
+    printf("band split, %d threads: %d mismatched frames\n", pass ? work.threadCount : 1, mismatches);
+    failures += mismatches;
+  }
+
+  printf("%s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+}
+
+/*
+ * Function Name: main
+ * Description: Program Entry, initializes window and main loop
+ * Parameters: argc - arg count
+ *             argv - args
+ *               --frames N exits after N frames (e.g. under Xvfb)
+ *               --no-huge-pages allocates on 4K pages
+ *               --bench N renders N frames offscreen on 4K then 2MB pages
+ *               --size WxH benchmark framebuffer size
+ *               --batch N renders N mixed scenes offscreen, --frames of them
+ *               --stats NAME shared memory counters, default /snow.<pid>
+ *               --no-stats skips collecting counters
+ *               --merge combines flakes that touch
+ *               --selftest checks redraws against full renders and exits
+ * Side Effects: Program execution
+ * Error Conditions: N/A
+ * Return Value: Exit code
+ */
+int
+main(int argc, char **argv) {
+  uint64_t frameLimit = 0;
+  int benchFrames = 0;
+  int benchWidth = 3840;
+  int benchHeight = 2160;
+  int batchScenes = 0;
+  char statsName[64];
+  snprintf(statsName, sizeof(statsName), "/snow.%d", (int)getpid());
+  bool useStats = true;
+  bool selfTest = false;
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frameLimit = strtoull(argv[++i], 0, 10);
+    }
+    else if(strcmp(argv[i], "--no-huge-pages") == 0) {
+      globalUseHugePages = false;
+    }
+    else if(strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+      benchFrames = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      sscanf(argv[++i], "%dx%d", &benchWidth, &benchHeight);
+    }
+    else if(strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+      batchScenes = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+      snprintf(statsName, sizeof(statsName), "%s", argv[++i]);
+    }
+    else if(strcmp(argv[i], "--no-stats") == 0) {
+      useStats = false;
+    }
+    else if(strcmp(argv[i], "--merge") == 0) {
+      globalMergeFlakes = true;
+    }
+    else if(strcmp(argv[i], "--selftest") == 0) {
+      selfTest = true;
+    }
+  }
+
+  char libraryPath[PATH_MAX];
+  LinuxGetLibraryPath(libraryPath, sizeof(libraryPath));
+  linuxSnowCode code = LinuxLoadSnowCode(libraryPath, 0);
+  if(!code.isValid) {
+    fprintf(stderr, "Unable to load %s\n", libraryPath);
+    return 1;
+  }
+
+  // Headless, invariants later kernel changes must keep
+  if(selfTest) {
+    return LinuxRunSelfTest(&code);
+  }
+
+  // Headless, many independent scenes
+  if(batchScenes > 0) {
+    Stats *stats = useStats ? LinuxOpenStats(statsName) : 0;
+    LinuxRunBatch(&code, frameLimit ? (int)frameLimit : 300, batchScenes, stats);
+    LinuxCloseStats(stats, statsName);
+    return 0;
+  }
+
+  // Headless, compares 4K pages against 2MB pages
+  if(benchFrames > 0) {
+    globalUseHugePages = false;
+    linuxBenchmarkResult small = LinuxRunBenchmark(&code, benchFrames, benchWidth, benchHeight);
+    globalUseHugePages = true;
+    linuxBenchmarkResult huge = LinuxRunBenchmark(&code, benchFrames, benchWidth, benchHeight);
+
+    printf("%dx%d, %d frames\n", benchWidth, benchHeight, benchFrames);
+    printf("4K pages: %8.3f ms/frame, dTLB misses %lld\n",
+           small.secondsPerFrame * 1000.0f, (long long)small.tlbMisses);
+    printf("2M pages: %8.3f ms/frame, dTLB misses %lld\n",
+           huge.secondsPerFrame * 1000.0f, (long long)huge.tlbMisses);
+    if(small.tlbMisses > 0 && huge.tlbMisses >= 0) {
+      printf("dTLB miss reduction: %.1f%%\n",
+             100.0f * (double)(small.tlbMisses - huge.tlbMisses) / (double)small.tlbMisses);
+    }
+    else {
+      printf("dTLB counters unavailable (check perf_event_paranoid)\n");
+    }
+    return 0;
+  }
+
+  // Window init
+  linuxPresenter presenter = {};
+  presenter.display = XOpenDisplay(0);
+  if(!presenter.display) {
+    fprintf(stderr, "Unable to open X display\n");
+    return 1;
+  }
+
+  int screen = DefaultScreen(presenter.display);
+  presenter.visual = DefaultVisual(presenter.display, screen);
+  presenter.depth = DefaultDepth(presenter.display, screen);
+  if(!LinuxGetPixelFormat(presenter.display, presenter.visual, presenter.depth, &presenter.format)) {
+    fprintf(stderr, "Unsupported visual, depth %d masks %lx %lx %lx\n", presenter.depth,
+            presenter.visual->red_mask, presenter.visual->green_mask, presenter.visual->blue_mask);
+    XCloseDisplay(presenter.display);
+    return 1;
+  }
+
+  int width = 960;
+  int height = 540;
+  presenter.window = XCreateSimpleWindow(presenter.display, RootWindow(presenter.display, screen),
+                                         0, 0, width, height, 0, 0,
+                                         BlackPixel(presenter.display, screen));
+  XStoreName(presenter.display, presenter.window, "Snow");
+  XSelectInput(presenter.display, presenter.window, StructureNotifyMask);
+
+  Atom wmDeleteWindow = XInternAtom(presenter.display, "WM_DELETE_WINDOW", False);
+  XSetWMProtocols(presenter.display, presenter.window, &wmDeleteWindow, 1);
+
+  presenter.gc = XCreateGC(presenter.display, presenter.window, 0, 0);
+  presenter.useShm = XShmQueryExtension(presenter.display);
+  presenter.completionEvent = XShmGetEventBase(presenter.display) + ShmCompletion;
+
+  XMapWindow(presenter.display, presenter.window);
+  if(!LinuxResizePresentBuffers(&presenter, width, height)) {
+    fprintf(stderr, "Unable to allocate %dx%d images\n", width, height);
+    LinuxFreePresentBuffers(&presenter);
+    XCloseDisplay(presenter.display);
+    return 1;
+  }
+
+  int monitorHZ = 60;
+  double targetFrameSeconds = 1.0f / (double)monitorHZ;
+
+  // Mapped memory is zeroed, so State starts cleared
+  Memory memory = {};
+  size_t memorySize;
+  memory.size = SNOW_MEMORY_SIZE;
+  memory.storage = LinuxReserve(memory.size, sizeof(State), &memorySize);
+  Assert(memory.storage);
+  memory.stats = useStats ? LinuxOpenStats(statsName) : 0;
+  memory.getNanoseconds = LinuxGetNanoseconds;
+  SetDefaultObstacles(&memory);
+  memory.mergeFlakes = globalMergeFlakes;
+
+  // Main loop
+  timespec lastCounter = LinuxGetWallClock();
+  // Use predicted value for first loop, and prior value for every other
+  double frameSecondsElapsed = targetFrameSeconds;
+  uint64_t frameCount = 0;
+  globalRunning = true;
+  while(globalRunning) {
+
+    // Message loop
+    while(XPending(presenter.display)) {
+      XEvent event;
+      XNextEvent(presenter.display, &event);
+      LinuxProcessEvent(&presenter, &event, wmDeleteWindow);
+    }
+
+    linuxPresentBuffer *back = LinuxAcquireBackBuffer(&presenter, wmDeleteWindow);
+    if(!globalRunning) {
+      break;
+    }
+
+    FrameBuffer buffer = {};
+    buffer.bitmap = back->image->data;
+    buffer.width = presenter.width;
+    buffer.height = presenter.height;
+    buffer.pitch = back->image->bytes_per_line;
+    buffer.pixelBytes = back->image->bits_per_pixel / 8;
+    buffer.format = presenter.format;
+    buffer.age = back->age;
+
+    // Picks up a rebuilt library between frames, scenes carry on from Memory
+    LinuxReloadSnowCodeIfChanged(&code, libraryPath);
+
+    // Uses the total frame time for the previous frame,
+    // which is only accurate with a consistent frame-rate
+    code.updateAndRender(&memory, &buffer, frameSecondsElapsed);
+    LinuxPresent(&presenter);
+
+    // Enforced framerate
+    frameSecondsElapsed = LinuxGetSecondsElapsed(lastCounter, LinuxGetWallClock());
+    if(frameSecondsElapsed < targetFrameSeconds) {
+      double sleepSeconds = targetFrameSeconds - frameSecondsElapsed;
+      timespec sleepTime = {0, (long)(sleepSeconds * 1e9)};
+      nanosleep(&sleepTime, 0);
+    }
+
+    timespec endCounter = LinuxGetWallClock();
+    frameSecondsElapsed = LinuxGetSecondsElapsed(lastCounter, endCounter);
+    lastCounter = endCounter;
+
+    frameCount++;
+    if(frameLimit && frameCount >= frameLimit) {
+      globalRunning = false;
+    }
+  }
+
+  LinuxFreePresentBuffers(&presenter);
+  XCloseDisplay(presenter.display);
+  LinuxCloseStats(memory.stats, statsName);
+  LinuxDeallocate(memory.storage, memorySize);
+  LinuxUnloadSnowCode(&code);
+  return 0;
+}
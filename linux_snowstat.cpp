@@ -0,0 +1,251 @@
+/*
+ * Filename: linux_snowstat.cpp
+ * Author: Kevin Hine
+ * Description: Monitor for the counters a running instance shares
+ * Date: Oct 18 2026
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "snow.h"
+#include "stats.cpp"
+
+// Summed over every slot
+struct statsTotals {
+  uint64_t frames;
+  uint64_t liveParticles;
+  uint64_t spawns;
+  uint64_t spawnFailures;
+  uint64_t culls;
+  uint64_t landed;
+  uint64_t merged;
+  uint64_t pixelsBlended;
+  uint64_t phaseHistogram[StatsPhase_Count][STATS_HISTOGRAM_BUCKETS];
+};
+
+/*
+ * Function Name: LoadCounter
+ * Description: Read a counter another process is adding to
+ * Parameters: counter - slot counter
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Counter value
+ */
+inline internal uint64_t
+LoadCounter(uint64_t *counter) {
+  uint64_t result = __atomic_load_n(counter, __ATOMIC_RELAXED);
+  return result;
+}
+
+/*
+ * Function Name: SumStats
+ * Description: Total every thread's slot
+ * Parameters: stats - shared counters
+ *             totals - result
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+SumStats(Stats *stats, statsTotals *totals) {
+  memset(totals, 0, sizeof(*totals));
+  for(int i = 0; i < STATS_MAX_THREADS; i++) {
+    StatsSlot *slot = stats->slots + i;
+    totals->frames += LoadCounter(&slot->frames);
+    totals->liveParticles += LoadCounter(&slot->liveParticles);
+    totals->spawns += LoadCounter(&slot->spawns);
+    totals->spawnFailures += LoadCounter(&slot->spawnFailures);
+    totals->culls += LoadCounter(&slot->culls);
+    totals->landed += LoadCounter(&slot->landed);
+    totals->merged += LoadCounter(&slot->merged);
+    totals->pixelsBlended += LoadCounter(&slot->pixelsBlended);
+    for(int phase = 0; phase < StatsPhase_Count; phase++) {
+      for(int bucket = 0; bucket < STATS_HISTOGRAM_BUCKETS; bucket++) {
+        totals->phaseHistogram[phase][bucket] += LoadCounter(&slot->phaseHistogram[phase][bucket]);
+      }
+    }
+  }
+}
+
+/*
+ * Function Name: GetPercentile
+ * Description: Duration below which a share of the counted phases fall
+ * Parameters: histogram - bucket counts
+ *             percentile - 0 to 1
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Lower bound of the bucket reaching the percentile in
+ *               nanoseconds, 0 if nothing was counted
+ */
+internal uint64_t
+GetPercentile(uint64_t *histogram, double percentile) {
+  uint64_t total = 0;
+  for(int bucket = 0; bucket < STATS_HISTOGRAM_BUCKETS; bucket++) {
+    total += histogram[bucket];
+  }
+
+  uint64_t target = (uint64_t)(total * percentile);
+  uint64_t seen = 0;
+  for(int bucket = 0; bucket < STATS_HISTOGRAM_BUCKETS; bucket++) {
+    seen += histogram[bucket];
+    if(total && seen > target) {
+      return GetStatsBucketMin(bucket);
+    }
+  }
+  return 0;
+}
+
+/*
+ * Function Name: OpenStats
+ * Description: Map a running instance's counters read only
+ * Parameters: name - POSIX shared memory name
+ * Side Effects: N/A
+ * Error Conditions: Returns 0 if missing or of another version
+ * Return Value: Shared counters
+ */
+internal Stats *
+OpenStats(const char *name) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if(fd < 0) {
+    fprintf(stderr, "No stats at %s\n", name);
+    return 0;
+  }
+
+  void *mapped = mmap(0, sizeof(Stats), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(mapped == MAP_FAILED) {
+    fprintf(stderr, "Unable to map %s\n", name);
+    return 0;
+  }
+
+  Stats *result = (Stats *)mapped;
+  if(__atomic_load_n(&result->magic, __ATOMIC_ACQUIRE) != STATS_MAGIC ||
+     result->version != STATS_VERSION || result->size != sizeof(Stats)) {
+    fprintf(stderr, "%s is not version %d snow stats\n", name, STATS_VERSION);
+    munmap(mapped, sizeof(Stats));
+    return 0;
+  }
+  return result;
+}
+
+/*
+ * Function Name: ListStats
+ * Description: Print the stats objects of running instances
+ * Parameters: N/A
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+ListStats() {
+  DIR *dir = opendir("/dev/shm");
+  if(!dir) {
+    return;
+  }
+
+  dirent *entry;
+  while((entry = readdir(dir))) {
+    if(strncmp(entry->d_name, "snow.", 5) == 0) {
+      int pid = atoi(entry->d_name + 5);
+      printf("/%s%s\n", entry->d_name, (kill(pid, 0) == 0) ? "" : " (exited)");
+    }
+  }
+  closedir(dir);
+}
+
+/*
+ * Function Name: main
+ * Description: Program Entry, prints counter rates once per interval
+ * Parameters: argc - arg count
+ *             argv - args
+ *               NAME or PID of the instance, lists instances if omitted
+ *               -i SECONDS interval between reports, default 1
+ *               -n COUNT exits after COUNT reports
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Exit code
+ */
+int
+main(int argc, char **argv) {
+  const char *target = 0;
+  double interval = 1.0f;
+  int reportLimit = 0;
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+      interval = atof(argv[++i]);
+    }
+    else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      reportLimit = atoi(argv[++i]);
+    }
+    else {
+      target = argv[i];
+    }
+  }
+
+  if(!target) {
+    ListStats();
+    return 0;
+  }
+
+  // Bare pids name the default object
+  char name[64];
+  if(target[0] >= '0' && target[0] <= '9') {
+    snprintf(name, sizeof(name), "/snow.%s", target);
+  }
+  else {
+    snprintf(name, sizeof(name), "%s", target);
+  }
+
+  Stats *stats = OpenStats(name);
+  if(!stats) {
+    return 1;
+  }
+
+  const char *phaseNames[StatsPhase_Count] = {"update", "render"};
+  local_persist statsTotals last;
+  local_persist statsTotals now;
+  SumStats(stats, &last);
+  for(int report = 0; !reportLimit || report < reportLimit; report++) {
+    timespec sleepTime = {(time_t)interval, (long)((interval - (time_t)interval) * 1e9)};
+    nanosleep(&sleepTime, 0);
+    SumStats(stats, &now);
+
+    // Counters only grow, so every delta is this interval's. Live is a count
+    // of now, slots are read at slightly different times so it may be off by
+    // a frame's change, even briefly below zero
+    int64_t live = (int64_t)now.liveParticles;
+    printf("pid %u: %llu live, frames %.1f/s, spawns %.1f/s, failed %.1f/s, "
+           "culled %.1f/s, landed %.1f/s, merged %.1f/s, %.2f Mpixels/s\n",
+           stats->pid, (unsigned long long)(live > 0 ? live : 0),
+           (now.frames - last.frames) / interval,
+           (now.spawns - last.spawns) / interval,
+           (now.spawnFailures - last.spawnFailures) / interval,
+           (now.culls - last.culls) / interval,
+           (now.landed - last.landed) / interval,
+           (now.merged - last.merged) / interval,
+           (now.pixelsBlended - last.pixelsBlended) / interval / 1e6);
+
+    for(int phase = 0; phase < StatsPhase_Count; phase++) {
+      uint64_t histogram[STATS_HISTOGRAM_BUCKETS];
+      for(int bucket = 0; bucket < STATS_HISTOGRAM_BUCKETS; bucket++) {
+        histogram[bucket] = now.phaseHistogram[phase][bucket] - last.phaseHistogram[phase][bucket];
+      }
+      printf("  %-6s p50 %8.1fus  p90 %8.1fus  p99 %8.1fus\n", phaseNames[phase],
+             GetPercentile(histogram, 0.50f) / 1e3,
+             GetPercentile(histogram, 0.90f) / 1e3,
+             GetPercentile(histogram, 0.99f) / 1e3);
+    }
+    fflush(stdout);
+    last = now;
+  }
+
+  munmap(stats, sizeof(Stats));
+  return 0;
+}
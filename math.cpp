@@ -23,10 +23,13 @@ Lerp(double a, double b, double percent) {
   return result;
 }
 
-// Rounds positive
+// Halves round up on both sides of zero, so offsetting by a whole number
+// offsets the result by the same amount
 internal inline int32_t
 RoundDoubleToInt32(double d) {
-  int32_t result = (int32_t)(d + 0.5f);
+  double shifted = d + 0.5f;
+  int32_t result = (int32_t)shifted;
+  result -= (shifted < result);
   return result;
 }
 
@@ -41,6 +44,20 @@ Abs(double d) {
   return (d < 0) ? -d : d;
 }
 
+internal inline int32_t
+FloorFloatToInt32(float f) {
+  int32_t result = (int32_t)f;
+  result -= (f < result);
+  return result;
+}
+
+internal inline int32_t
+FloorDoubleToInt32(double d) {
+  int32_t result = (int32_t)d;
+  result -= (d < result);
+  return result;
+}
+
 // Bit-conversion to a double [0,1)
 internal inline double
 ToDouble(uint64_t x) {
@@ -51,7 +68,34 @@ ToDouble(uint64_t x) {
 // Random Number Generator
 // xoroshiro128+ by David Blackman and Sebastiano Vigna
 // http://xoroshiro.di.unimi.it/xoroshiro128plus.c
-global_variable uint64_t randomSeed[2];
+// State lives in RandomSeries so independent scenes don't share a sequence
+
+/*
+ * Function Name: SeedRandom
+ * Description: Expand a 64 bit seed into generator state with splitmix64, as
+ *              the xoroshiro authors recommend. Seed 0 keeps the original
+ *              fixed sequence
+ * Parameters: series - generator state
+ *             seed - any value
+ * Side Effects: Overwrites state bits
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+SeedRandom(RandomSeries *series, uint64_t seed) {
+  if(seed == 0) {
+    series->state[0] = 0x0bdb1dd352d7ddd4;
+    series->state[1] = 0x009b18cd16d1df52;
+    return;
+  }
+
+  for(int i = 0; i < 2; i++) {
+    uint64_t z = (seed += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    series->state[i] = z ^ (z >> 31);
+  }
+}
 
 /*
  * Function Name: rotl
@@ -70,20 +114,20 @@ rotl(const uint64_t x, int k) {
 /*
  * Function Name: Random
  * Description: Generate random 64 bit number
- * Parameters: N/A
+ * Parameters: series - generator state
  * Side Effects: Updates state bits
  * Error Conditions: N/A
  * Return Value: Result
  */
 internal uint64_t
-Random() {
-  const uint64_t s0 = randomSeed[0];
-  uint64_t s1 = randomSeed[1];
+Random(RandomSeries *series) {
+  const uint64_t s0 = series->state[0];
+  uint64_t s1 = series->state[1];
   const uint64_t result = s0 + s1;
 
   s1 ^= s0;
-  randomSeed[0] = rotl(s0, 55) ^ s1 ^ (s1 << 14);
-  randomSeed[1] = rotl(s1, 36);
+  series->state[0] = rotl(s0, 55) ^ s1 ^ (s1 << 14);
+  series->state[1] = rotl(s1, 36);
 
   return result;
 }
@@ -91,14 +135,14 @@ Random() {
 /*
  * Function Name: RandomPercent
  * Description: Generate random double
- * Parameters: N/A
+ * Parameters: series - generator state
  * Side Effects: Updates state bits
  * Error Conditions: N/A
  * Return Value: Result
  */
 internal inline double
-RandomPercent() {
-  double result = ToDouble(Random());
+RandomPercent(RandomSeries *series) {
+  double result = ToDouble(Random(series));
   return result;
 }
 
@@ -106,13 +150,13 @@ RandomPercent() {
  * Function Name: jump
  * Description: Equivalent to 2^64 calls to Random(), able to generate 2^64
  *              non-overlapping subsequences for parallel computations
- * Parameters: N/A
+ * Parameters: series - generator state
  * Side Effects: Updates state bits
  * Error Conditions: N/A
  * Return Value: N/A
  */
 internal void
-jump() {
+jump(RandomSeries *series) {
   static const uint64_t JUMP[] = { 0xbeac0467eba5facb, 0xd86b048b86aa9922 };
 
   uint64_t s0 = 0;
@@ -120,12 +164,60 @@ jump() {
   for(size_t i = 0; i < sizeof JUMP / sizeof *JUMP; i++)
     for(int b = 0; b < 64; b++) {
       if (JUMP[i] & (uint64_t)1 << b) {
-        s0 ^= randomSeed[0];
-        s1 ^= randomSeed[1];
+        s0 ^= series->state[0];
+        s1 ^= series->state[1];
       }
-      Random();
+      Random(series);
     }
 
-  randomSeed[0] = s0;
-  randomSeed[1] = s1;
+  series->state[0] = s0;
+  series->state[1] = s1;
+}
+
+/*
+ * Function Name: LatticeValue
+ * Description: Hash an integer lattice point to a fixed pseudo-random value
+ * Parameters: x - lattice column
+ *             y - lattice row
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Result in [-1, 1]
+ */
+internal inline float
+LatticeValue(int32_t x, int32_t y) {
+  uint32_t h = ((uint32_t)x * 0x8da6b343) ^ ((uint32_t)y * 0xd8163841);
+  h = (h ^ (h >> 15)) * 0x2c1b3c6d;
+  h ^= h >> 12;
+  float result = (float)(h & 0xffff) * (2.0f / 65535.0f) - 1.0f;
+  return result;
+}
+
+/*
+ * Function Name: ValueNoise
+ * Description: Smoothly interpolated lattice noise
+ * Parameters: x - horizontal pos, one lattice cell per unit
+ *             y - vertical pos
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Result in [-1, 1]
+ */
+internal float
+ValueNoise(float x, float y) {
+  int32_t ix = FloorFloatToInt32(x);
+  int32_t iy = FloorFloatToInt32(y);
+  float fx = x - ix;
+  float fy = y - iy;
+
+  // Smoothstep so the gradient is continuous across cells
+  fx = fx * fx * (3 - 2 * fx);
+  fy = fy * fy * (3 - 2 * fy);
+
+  float topLeft = LatticeValue(ix, iy);
+  float topRight = LatticeValue(ix + 1, iy);
+  float bottomLeft = LatticeValue(ix, iy + 1);
+  float bottomRight = LatticeValue(ix + 1, iy + 1);
+  float top = topLeft + fx * (topRight - topLeft);
+  float bottom = bottomLeft + fx * (bottomRight - bottomLeft);
+  float result = top + fy * (bottom - top);
+  return result;
 }
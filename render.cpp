@@ -61,28 +61,176 @@ GetDoubleColor(uint32_t c) {
 }
 
 /*
- * Function Name: Composite
- * Description: Overlay src on desitantion by alpha
- * Parameters: src - additive color
- *             dest - initial color
- *             percent - color lerp amount
+ * Function Name: AlphaToFixed
+ * Description: Convert 0-1.0 alpha to 0-256 fixed point blend weight
+ * Parameters: alpha - blend amount
  * Side Effects: N/A
  * Error Conditions: N/A
  * Return Value: Result
  */
-inline internal Color
-Composite(Color src, Color dest, double percent) {
-  if(percent == 1) {
-    return src;
-  }
-  Color result;
-  result.a = src.a;
-  result.r = Lerp(src.r, dest.r, percent);
-  result.g = Lerp(src.g, dest.g, percent);
-  result.b = Lerp(src.b, dest.b, percent);
+inline internal uint32_t
+AlphaToFixed(double alpha) {
+  uint32_t result = RoundDoubleToUInt32(alpha * 256.0f);
+  return result;
+}
+
+/*
+ * Function Name: Blend8888
+ * Description: Lerp the three low channels of a 32-bit pixel, keeping the
+ *              source's top (alpha) channel. Shared by the 8888 formats
+ * Parameters: dest - initial pixel
+ *             src - additive pixel
+ *             alpha - fixed point blend weight 0-256
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Result
+ */
+inline internal uint32_t
+Blend8888(uint32_t dest, uint32_t src, uint32_t alpha) {
+  int32_t dest0 = (dest >> 0) & 0xff;
+  int32_t dest1 = (dest >> 8) & 0xff;
+  int32_t dest2 = (dest >> 16) & 0xff;
+  int32_t src0 = (src >> 0) & 0xff;
+  int32_t src1 = (src >> 8) & 0xff;
+  int32_t src2 = (src >> 16) & 0xff;
+  uint32_t c0 = dest0 + (((src0 - dest0) * (int32_t)alpha) >> 8);
+  uint32_t c1 = dest1 + (((src1 - dest1) * (int32_t)alpha) >> 8);
+  uint32_t c2 = dest2 + (((src2 - dest2) * (int32_t)alpha) >> 8);
+  uint32_t result = (src & 0xff000000) | (c2 << 16) | (c1 << 8) | c0;
   return result;
 }
 
+// Pixel formats pack a Color into the target's layout and blend a packed
+// source over a destination pixel by a 0-256 weight, keeping src alpha.
+// Blends must stay branch-free so span loops vectorize
+
+// 32-bit little endian argb, bytes b g r a
+struct FormatBGRA8888 {
+  typedef uint32_t Pixel;
+
+  static inline Pixel
+  Pack(Color c) {
+    return c.argb;
+  }
+
+  static inline Pixel
+  Blend(Pixel dest, Pixel src, uint32_t alpha) {
+    return Blend8888(dest, src, alpha);
+  }
+};
+
+// 32-bit little endian abgr, bytes r g b a
+struct FormatRGBA8888 {
+  typedef uint32_t Pixel;
+
+  static inline Pixel
+  Pack(Color c) {
+    return ((uint32_t)c.a << 24) | ((uint32_t)c.b << 16) | ((uint32_t)c.g << 8) | c.r;
+  }
+
+  static inline Pixel
+  Blend(Pixel dest, Pixel src, uint32_t alpha) {
+    return Blend8888(dest, src, alpha);
+  }
+};
+
+// 16-bit rgb, 5 red bits high, no alpha
+struct FormatRGB565 {
+  typedef uint16_t Pixel;
+
+  static inline Pixel
+  Pack(Color c) {
+    return (Pixel)(((c.r >> 3) << 11) | ((c.g >> 2) << 5) | (c.b >> 3));
+  }
+
+  static inline Pixel
+  Blend(Pixel dest, Pixel src, uint32_t alpha) {
+    int32_t destR = (dest >> 11) & 0x1f;
+    int32_t destG = (dest >> 5) & 0x3f;
+    int32_t destB = (dest >> 0) & 0x1f;
+    int32_t srcR = (src >> 11) & 0x1f;
+    int32_t srcG = (src >> 5) & 0x3f;
+    int32_t srcB = (src >> 0) & 0x1f;
+    uint32_t r = destR + (((srcR - destR) * (int32_t)alpha) >> 8);
+    uint32_t g = destG + (((srcG - destG) * (int32_t)alpha) >> 8);
+    uint32_t b = destB + (((srcB - destB) * (int32_t)alpha) >> 8);
+    return (Pixel)((r << 11) | (g << 5) | b);
+  }
+};
+
+// 8-bit luminance, no alpha
+struct FormatGray8 {
+  typedef uint8_t Pixel;
+
+  // Rec. 601 luma weights scaled to 256
+  static inline Pixel
+  Pack(Color c) {
+    return (Pixel)((77 * c.r + 150 * c.g + 29 * c.b) >> 8);
+  }
+
+  static inline Pixel
+  Blend(Pixel dest, Pixel src, uint32_t alpha) {
+    return (Pixel)(dest + (((src - dest) * (int32_t)alpha) >> 8));
+  }
+};
+
+/*
+ * Function Name: FillSpan
+ * Description: Composite a horizontal run of pixels with constant coverage
+ * Parameters: pixel - first pixel of the span
+ *             count - span length
+ *             src - span color in the target format
+ *             alpha - fixed point blend weight, unused when opaque
+ * Side Effects: Writes count pixels
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+template<typename Format, BlendMode mode>
+inline internal void
+FillSpan(typename Format::Pixel *pixel, int count, typename Format::Pixel src, uint32_t alpha) {
+  for(int i = 0; i < count; i++) {
+    if constexpr(mode == BlendMode_Opaque) {
+      pixel[i] = src;
+    }
+    else {
+      pixel[i] = Format::Blend(pixel[i], src, alpha);
+    }
+  }
+}
+
+/*
+ * Function Name: FillRow
+ * Description: Draw one row of a rect, partial coverage edge pixels on either
+ *              side of a constant coverage interior span
+ * Parameters: pixel - first pixel of the row
+ *             width - row length
+ *             src - row color in the target format
+ *             rowAlpha - alpha times the row's vertical coverage
+ *             minXFill - left pixel coverage
+ *             maxXFill - right pixel coverage
+ * Side Effects: Writes width pixels
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+template<typename Format>
+internal void
+FillRow(typename Format::Pixel *pixel, int width, typename Format::Pixel src,
+        double rowAlpha, double minXFill, double maxXFill) {
+  if(width == 1) {
+    *pixel = Format::Blend(*pixel, src, AlphaToFixed(rowAlpha * minXFill * maxXFill));
+    return;
+  }
+
+  pixel[0] = Format::Blend(pixel[0], src, AlphaToFixed(rowAlpha * minXFill));
+  if(rowAlpha == 1) {
+    FillSpan<Format, BlendMode_Opaque>(pixel + 1, width - 2, src, 256);
+  }
+  else {
+    FillSpan<Format, BlendMode_Alpha>(pixel + 1, width - 2, src, AlphaToFixed(rowAlpha));
+  }
+  pixel[width - 1] = Format::Blend(pixel[width - 1], src, AlphaToFixed(rowAlpha * maxXFill));
+}
+
 /*
  * Function Name: FillRect
  * Description: Draw filled rectangle to framebuffer
@@ -94,9 +242,10 @@ Composite(Color src, Color dest, double percent) {
  *             srcColor - rect color
  * Side Effects: Fills framebuffer with tiled gradient
  * Error Conditions: N/A
- * Return Value: N/A
+ * Return Value: Pixels written
  */
-internal void
+template<typename Format>
+internal uint32_t
 FillRect(FrameBuffer *buffer, double startX, double startY, double endX, double endY, Color srcColor) {
   int32_t minX = RoundDoubleToInt32(startX);
   int32_t minY = RoundDoubleToInt32(startY);
@@ -108,49 +257,351 @@ FillRect(FrameBuffer *buffer, double startX, double startY, double endX, double
   double maxXFill = Abs(endX - maxX);
   double maxYFill = Abs(endY - maxY);
 
-  // Clamp
-  if(minX <= 0) {
+  // Clamp, edges that land exactly on the border keep their coverage so a
+  // rect drawn across adjacent band views matches one drawn whole
+  if(minX < 0) {
     minX = 0;
     minXFill = 1;
   }
-  if(minY <= 0) {
+  if(minY < 0) {
     minY = 0;
     minYFill = 1;
   }
-  if(maxX >= buffer->width) {
+  if(maxX > buffer->width) {
     maxX = buffer->width;
     maxXFill = 1;
   }
-  if(maxY >= buffer->height) {
+  if(maxY > buffer->height) {
     maxY = buffer->height;
     maxYFill = 1;
   }
+  if(minX >= maxX || minY >= maxY) {
+    return 0;
+  }
+
+  int width = maxX - minX;
+  double alpha = (srcColor.a / 255.0f);
+  typename Format::Pixel src = Format::Pack(srcColor);
 
+  // Top and bottom edge strips carry their partial coverage for the whole row,
+  // leaving the interior rows a constant alpha
   uint8_t *row = GetPixel(buffer, minX, minY);
-  for(int y = minY; y < maxY; y++) {
+  if(maxY - minY == 1) {
+    FillRow<Format>((typename Format::Pixel *)row, width, src, alpha * minYFill * maxYFill, minXFill, maxXFill);
+    return width;
+  }
 
-    uint32_t *pixel = (uint32_t *)row;
-    for(int x = minX; x < maxX; x++) {
+  FillRow<Format>((typename Format::Pixel *)row, width, src, alpha * minYFill, minXFill, maxXFill);
+  row += buffer->pitch;
+  for(int y = minY + 1; y < maxY - 1; y++) {
+    FillRow<Format>((typename Format::Pixel *)row, width, src, alpha, minXFill, maxXFill);
+    row += buffer->pitch;
+  }
+  FillRow<Format>((typename Format::Pixel *)row, width, src, alpha * maxYFill, minXFill, maxXFill);
+  return width * (maxY - minY);
+}
 
-      // Compositing
-      Color destColor = {*pixel};
-      double alpha = (srcColor.a / 255.0f);
+/*
+ * Function Name: GetDiscSegmentArea
+ * Description: Area of a disc cut off by a chord. acos is Abramowitz and
+ *              Stegun 4.4.46, off by under 2e-8, so float rounding is the
+ *              larger error
+ * Parameters: distance - chord distance from the center, 0 to radius
+ *             halfChord - half the chord, sqrt(radius^2 - distance^2)
+ *             radius - disc radius
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Result
+ */
+inline internal float
+GetDiscSegmentArea(float distance, float halfChord, float radius) {
+  float a = Min(distance / radius, 1.0f);
+  float acosA = sqrtf(1 - a) * (1.5707963f + a * (-0.2145988f + a * (0.0889790f + a * (-0.0501743f +
+                a * (0.0308919f + a * (-0.0170881f + a * (0.0066701f + a * -0.0012625f)))))));
+  float result = radius * radius * acosA - distance * halfChord;
+  return result;
+}
 
-      // Partial pixel alpha multiplier
-      double fillRatio = 1;
-      if(y == minY) fillRatio *= minYFill;
-      if(x == minX) fillRatio *= minXFill;
-      if(y == maxY - 1) fillRatio *= maxYFill;
-      if(x == maxX - 1) fillRatio *= maxXFill;
+/*
+ * Function Name: GetDiscAreaLeftOf
+ * Description: Area of a disc centered on the origin left of a vertical line
+ * Parameters: x - line pos
+ *             radius - disc radius
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Result
+ */
+inline internal float
+GetDiscAreaLeftOf(float x, float radius) {
+  float distance = Min((x < 0) ? -x : x, radius);
+  float segment = GetDiscSegmentArea(distance, sqrtf(radius * radius - distance * distance), radius);
+  float result = (x < 0) ? segment : 3.1415927f * radius * radius - segment;
+  return result;
+}
 
-      double percent = alpha * fillRatio;
-      Color color = Composite(srcColor, destColor, percent);
-      *pixel++ = color.argb;
+/*
+ * Function Name: GetDiscLine
+ * Description: Where a horizontal line crosses a disc centered on the origin
+ * Parameters: y - line pos
+ *             radius - disc radius
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Result
+ */
+inline internal DiscLine
+GetDiscLine(float y, float radius) {
+  DiscLine result;
+  result.y = y;
+  result.halfWidth = sqrtf(Max(radius * radius - y * y, 0.0f));
+  // The chord's ends cut vertical segments whose half chord is |y|
+  result.areaLeftOfMin = GetDiscSegmentArea(result.halfWidth, (y < 0) ? -y : y, radius);
+  result.areaLeftOfMax = 3.1415927f * radius * radius - result.areaLeftOfMin;
+  return result;
+}
+
+/*
+ * Function Name: GetDiscCornerArea
+ * Description: Area of a disc centered on the origin that is both left of
+ *              a vertical line and above a horizontal one
+ * Parameters: x - vertical line pos
+ *             areaLeftOfX - GetDiscAreaLeftOf x
+ *             line - horizontal line
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Result
+ */
+inline internal float
+GetDiscCornerArea(float x, float areaLeftOfX, DiscLine *line) {
+  // Cap cut off by whichever of the line or its mirror is above the center,
+  // taken left of x. Its columns are the disc's height less the line's depth
+  float w = line->halfWidth;
+  float capX = Min(Max(x, -w), w);
+  // Disc area only grows with x, so clamping it matches clamping x
+  float areaLeftOfCapX = Min(Max(areaLeftOfX, line->areaLeftOfMin), line->areaLeftOfMax);
+  float depth = (line->y < 0) ? -line->y : line->y;
+  float cap = 0.5f * (areaLeftOfCapX - line->areaLeftOfMin) - depth * (capX + w);
+
+  float result = (line->y <= 0) ? cap : areaLeftOfX - cap;
+  return result;
+}
+
+// Column edges whose disc areas FillCircle computes once for every row,
+// wider discs compute them per row
+#define FILL_CIRCLE_MAX_COLUMNS 64
+
+/*
+ * Function Name: FillCircleEdge
+ * Description: Blend a run of pixels along a disc's edge, each by the share
+ *              of its area inside. That share is the difference of the disc
+ *              areas within the row left of the pixel's two sides
+ * Parameters: pixel - row, indexed by x
+ *             minX - first pixel
+ *             maxX - last pixel
+ *             centerX - disc center x pos
+ *             radius - disc radius
+ *             top - disc line along the row's top
+ *             bottom - disc line along the row's bottom
+ *             columnArea - disc areas left of column edges from firstColumn,
+ *                          0 to compute them here
+ *             firstColumn - column edge of columnArea[0]
+ *             src - disc color in the target format
+ *             edgeAlpha - color alpha in 0-256 blend steps
+ * Side Effects: Writes maxX - minX + 1 pixels
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+template<typename Format>
+inline internal void
+FillCircleEdge(typename Format::Pixel *pixel, int minX, int maxX, double centerX, float radius,
+               DiscLine *top, DiscLine *bottom, float *columnArea, int firstColumn,
+               typename Format::Pixel src, float edgeAlpha) {
+  if(minX > maxX) {
+    return;
+  }
+
+  float left = (float)(minX - centerX);
+  float areaLeftOfLeft = columnArea ? columnArea[minX - firstColumn] : GetDiscAreaLeftOf(left, radius);
+  float rowAreaLeftOfLeft = GetDiscCornerArea(left, areaLeftOfLeft, bottom) -
+                            GetDiscCornerArea(left, areaLeftOfLeft, top);
+  for(int x = minX; x <= maxX; x++) {
+    float right = (float)((x + 1) - centerX);
+    float areaLeftOfRight = columnArea ? columnArea[x + 1 - firstColumn] : GetDiscAreaLeftOf(right, radius);
+    float rowAreaLeftOfRight = GetDiscCornerArea(right, areaLeftOfRight, bottom) -
+                               GetDiscCornerArea(right, areaLeftOfRight, top);
+
+    float coverage = Min(Max(rowAreaLeftOfRight - rowAreaLeftOfLeft, 0.0f), 1.0f);
+    pixel[x] = Format::Blend(pixel[x], src, (uint32_t)(edgeAlpha * coverage + 0.5f));
+    rowAreaLeftOfLeft = rowAreaLeftOfRight;
+  }
+}
+
+/*
+ * Function Name: FillCircle
+ * Description: Draw an anti-aliased disc, each pixel covered by the exact
+ *              share of its area inside the disc. Per row, the span of
+ *              pixels fully inside goes through the span kernels, only the
+ *              edge pixels either side of it are measured. Their areas come
+ *              from one disc area per column edge and one chord per row
+ *              edge, so there is no per-pixel root
+ * Parameters: buffer - framebuffer
+ *             centerX - center x pos
+ *             centerY - center y pos
+ *             radius - disc radius
+ *             srcColor - disc color
+ * Side Effects: Blends the disc into the framebuffer
+ * Error Conditions: N/A
+ * Return Value: Pixels written
+ */
+template<typename Format>
+internal uint32_t
+FillCircle(FrameBuffer *buffer, double centerX, double centerY, double radius, Color srcColor) {
+  float r = (float)radius;
+  int minY = Max(FloorDoubleToInt32(centerY - radius), 0);
+  int maxY = Min(-FloorDoubleToInt32(-(centerY + radius)), buffer->height) - 1;
+  int firstColumn = Max(FloorDoubleToInt32(centerX - radius), 0);
+  int lastColumn = Min(-FloorDoubleToInt32(-(centerX + radius)), buffer->width);
+  if(r <= 0 || minY > maxY || firstColumn >= lastColumn) {
+    return 0;
+  }
+
+  // Flake sized discs reach every column edge from several rows
+  float columnAreaStorage[FILL_CIRCLE_MAX_COLUMNS + 1];
+  float *columnArea = 0;
+  if(lastColumn - firstColumn <= FILL_CIRCLE_MAX_COLUMNS) {
+    columnArea = columnAreaStorage;
+    for(int x = firstColumn; x <= lastColumn; x++) {
+      columnArea[x - firstColumn] = GetDiscAreaLeftOf((float)(x - centerX), r);
+    }
+  }
+
+  uint32_t spanAlpha = AlphaToFixed(srcColor.a / 255.0f);
+  float edgeAlpha = srcColor.a * (256.0f / 255.0f);
+  typename Format::Pixel src = Format::Pack(srcColor);
+
+  // Row edges are offset in double so a band view of the buffer gets the
+  // same rows
+  uint32_t result = 0;
+  uint8_t *row = GetPixel(buffer, 0, minY);
+  DiscLine top = GetDiscLine((float)(minY - centerY), r);
+  for(int y = minY; y <= maxY; y++, row += buffer->pitch) {
+    DiscLine bottom = GetDiscLine((float)((y + 1) - centerY), r);
+    float minHalfWidth = Min(top.halfWidth, bottom.halfWidth);
+    float maxHalfWidth = (top.y < 0 && bottom.y > 0) ? r : Max(top.halfWidth, bottom.halfWidth);
+
+    // Pixels the row's widest chord reaches, and those inside its narrowest
+    int minX = Max(FloorDoubleToInt32(centerX - maxHalfWidth), firstColumn);
+    int maxX = Min(-FloorDoubleToInt32(-(centerX + maxHalfWidth)), lastColumn) - 1;
+    int spanMinX = Max(-FloorDoubleToInt32(-(centerX - minHalfWidth)), minX);
+    int spanMaxX = Min(FloorDoubleToInt32(centerX + minHalfWidth) - 1, maxX);
+    if(spanMinX > spanMaxX) {
+      spanMinX = maxX + 1;
+      spanMaxX = maxX;
+    }
+
+    typename Format::Pixel *pixel = (typename Format::Pixel *)row;
+    FillCircleEdge<Format>(pixel, minX, spanMinX - 1, centerX, r, &top, &bottom,
+                           columnArea, firstColumn, src, edgeAlpha);
+    if(spanAlpha >= 256) {
+      FillSpan<Format, BlendMode_Opaque>(pixel + spanMinX, spanMaxX - spanMinX + 1, src, 256);
+    }
+    else {
+      FillSpan<Format, BlendMode_Alpha>(pixel + spanMinX, spanMaxX - spanMinX + 1, src, spanAlpha);
+    }
+    FillCircleEdge<Format>(pixel, spanMaxX + 1, maxX, centerX, r, &top, &bottom,
+                           columnArea, firstColumn, src, edgeAlpha);
+
+    if(minX <= maxX) {
+      result += maxX - minX + 1;
+    }
+    top = bottom;
+  }
+  return result;
+}
+
+/*
+ * Function Name: FillPixelRect
+ * Description: Draw a pixel aligned rectangle with full coverage
+ * Parameters: buffer - framebuffer
+ *             minX - first column
+ *             minY - first row
+ *             maxX - column past the end
+ *             maxY - row past the end
+ *             srcColor - rect color
+ * Side Effects: Fills framebuffer region
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+template<typename Format>
+internal void
+FillPixelRect(FrameBuffer *buffer, int minX, int minY, int maxX, int maxY, Color srcColor) {
+  minX = Max(minX, 0);
+  minY = Max(minY, 0);
+  maxX = Min(maxX, buffer->width);
+  maxY = Min(maxY, buffer->height);
+  if(minX >= maxX || minY >= maxY) {
+    return;
+  }
+
+  typename Format::Pixel src = Format::Pack(srcColor);
+  uint32_t alpha = AlphaToFixed(srcColor.a / 255.0f);
+  uint8_t *row = GetPixel(buffer, minX, minY);
+  for(int y = minY; y < maxY; y++) {
+    if(srcColor.a == 255) {
+      FillSpan<Format, BlendMode_Opaque>((typename Format::Pixel *)row, maxX - minX, src, alpha);
+    }
+    else {
+      FillSpan<Format, BlendMode_Alpha>((typename Format::Pixel *)row, maxX - minX, src, alpha);
     }
     row += buffer->pitch;
   }
 }
 
+/*
+ * Function Name: GetParticleDepth
+ * Description: Unpack particle depth
+ * Parameters: p - particle
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: 0-1.0 depth, 1 nearest
+ */
+inline internal float
+GetParticleDepth(Particle *p) {
+  float result = p->z * (1.0f / 255.0f);
+  return result;
+}
+
+/*
+ * Function Name: GetParticleRadius
+ * Description: Nearer particles are larger
+ * Parameters: p - particle
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Radius in pixels
+ */
+inline internal float
+GetParticleRadius(Particle *p) {
+  float result = PARTICLE_MIN_RADIUS + PARTICLE_RADIUS_RANGE * GetParticleDepth(p);
+  return result;
+}
+
+/*
+ * Function Name: GetParticleAlpha
+ * Description: Nearer particles are more opaque, and all fade out as they
+ *              near the end of their lifetime
+ * Parameters: p - particle
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: 0-1.0 alpha
+ */
+inline internal float
+GetParticleAlpha(Particle *p) {
+  float result = 0.25f + 0.75f * GetParticleDepth(p);
+  for(int fade = p->lifetime; fade < 19; fade++) {
+    result *= 0.8f;
+  }
+  return result;
+}
+
 /*
  * Function Name: RenderGradient
  * Description: Debugging function for frame timing, color endian-ness
@@ -160,32 +611,37 @@ FillRect(FrameBuffer *buffer, double startX, double startY, double endX, double
  * Error Conditions: N/A
  * Return Value: N/A
  */
+template<typename Format>
 internal void
 RenderGradient(FrameBuffer *buffer, int var) {
   uint8_t *row = (uint8_t *)buffer->bitmap;
   for(int y = 0; y < buffer->height; y++) {
-    uint32_t *pixel = (uint32_t *)row;
+    typename Format::Pixel *pixel = (typename Format::Pixel *)row;
     for(int x = 0; x < buffer->width; x++) {
-      int red = (uint8_t)var;
-      int green = (uint8_t)(y + var);
-      int blue = (uint8_t)(x + var);
-      *pixel++ = (red << 16) | (green << 8) | (blue);
+      Color c;
+      c.a = 0;
+      c.r = (uint8_t)var;
+      c.g = (uint8_t)(y + var);
+      c.b = (uint8_t)(x + var);
+      *pixel++ = Format::Pack(c);
     }
     row += buffer->pitch;
   }
 }
 
+template<typename Format>
 internal void
 RenderGradient2(FrameBuffer *buffer, int var) {
   uint8_t *row = (uint8_t *)buffer->bitmap;
   for(int y = 0; y < buffer->height; y++) {
-    uint32_t *pixel = (uint32_t *)row;
+    typename Format::Pixel *pixel = (typename Format::Pixel *)row;
     for(int x = 0; x < buffer->width; x++) {
-      int alpha = (uint8_t)var;
-      int red = (uint8_t)var;
-      int green = (uint8_t)var;
-      int blue = (uint8_t)var;
-      *pixel++ = (alpha << 24) | (red << 16) | (green << 8) | (blue);
+      Color c;
+      c.a = (uint8_t)var;
+      c.r = (uint8_t)var;
+      c.g = (uint8_t)var;
+      c.b = (uint8_t)var;
+      *pixel++ = Format::Pack(c);
     }
     row += buffer->pitch;
   }
@@ -28,34 +28,60 @@ struct Color {
   };
 };
 
-struct Mask {
+// Span kernels are specialized on blend mode so the interior loop carries no
+// per-pixel coverage or alpha checks
+enum BlendMode {
+  BlendMode_Opaque, // Source replaces destination
+  BlendMode_Alpha,  // Constant alpha across the span
+};
+
+// Horizontal line across a disc centered on the origin, see FillCircle
+struct DiscLine {
+  float y;
+  // Half the chord, 0 if the line misses the disc
+  float halfWidth;
+  // Disc area left of either end of the chord
+  float areaLeftOfMin;
+  float areaLeftOfMax;
+};
+
+struct AlphaMask {
   int width;
   int height;
   double *pixel;
 };
 
-// When lifetime is 0, the particle is not in use, so other data fields can be 
-// used as a linked list of free particles
+#define PARTICLE_PALETTE_SIZE 32
+// Radius grows with depth from min to min + range
+#define PARTICLE_MIN_RADIUS 2.5f
+#define PARTICLE_RADIUS_RANGE 2.0f
+#define PARTICLE_MAX_RADIUS (PARTICLE_MIN_RADIUS + PARTICLE_RADIUS_RANGE)
+// Flakes further apart in z than this pass each other instead of merging
+#define PARTICLE_MERGE_DEPTH 8
+// Terminal fall speed in pixels per second, before depth scaling
+#define PARTICLE_FALL_SPEED 100.0f
+// Fraction of the gap to the wind velocity closed per second
+#define PARTICLE_WIND_RESPONSE 1.5f
+#define PARTICLE_NONE 0xffffffff
+
+// Compact flake, 20 bytes. Radius and alpha are derived from z, and color is
+// a palette index. Velocity stays in float pixels per second, the wind
+// updates it every frame. When lifetime is 0, the particle is not in use, so
+// the position can be used as a linked list of free particle indices
 struct Particle {
-  uint32_t lifetime; //Particle lifetime in frames
   union {
-    Particle *next;
+    uint32_t next;
     struct {
-      double x;
-      double y;
-      double z;
-      double velX;
-      double velY;
-      double startVelX;
-      double startVelY;
-      double targetVelX;
-      double targetVelY;
-      double lerp;
-      double lerpSpeed;
-      double radius;
-      DoubleColor color;
+      float x;
+      float y;
     };
   };
+  float velX;
+  float velY;
+  uint16_t lifetime : 10; // Particle lifetime in frames
+  uint16_t color : 5;     // Palette index
+  uint16_t settled : 1;   // Resting on an obstacle, no longer animated
+  uint8_t z;              // Depth, 0 far to 255 near
 };
 
 #endif /* RENDER_H */
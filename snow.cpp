@@ -5,54 +5,168 @@
  * Date: Sep 06 2017
  */
 
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
 #include "snow.h"
 #include "math.cpp"
+#include "stats.cpp"
 #include "render.cpp"
+#include "spatial.cpp"
+#include "snowpack.cpp"
 
 /*
  * Function Name: DrawParticle
  * Description: Render particle
  * Parameters: buffer - framebuffer
+ *             palette - particle colors
  *             p - particle
+ *             originY - scene row at the top of buffer
  * Side Effects: Render particle to framebuffer
  * Error Conditions: N/A
+ * Return Value: Pixels blended
+ */
+template<typename Format>
+internal uint32_t
+DrawParticle(FrameBuffer *buffer, Color *palette, Particle *p, double originY) {
+  Color c = palette[p->color];
+  c.a = RoundDoubleToUInt32(GetParticleAlpha(p) * 255.0f);
+  // Offset in double precision so every band sees the same center
+  return FillCircle<Format>(buffer, p->x, p->y - originY, GetParticleRadius(p), c);
+}
+
+/*
+ * Function Name: InitPalette
+ * Description: Fill particle colors, hues from cyan to lavender
+ * Parameters: palette - particle colors
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+InitPalette(Color *palette) {
+  for(int i = 0; i < PARTICLE_PALETTE_SIZE; i++) {
+    double hue = (double)i / (PARTICLE_PALETTE_SIZE - 1);
+    DoubleColor color;
+    color.a = 1;
+    color.r = Lerp(0.3f, 0.5f, hue);
+    color.g = Lerp(0.9f, 0.5f, hue);
+    color.b = Lerp(1.0f, 1.0f, hue);
+    palette[i] = GetColor(color);
+  }
+}
+
+/*
+ * Function Name: UpdateWindField
+ * Description: Advance the wind grid. Velocities are the curl of scrolling
+ *              noise, so gusts swirl and drift across the screen without
+ *              converging
+ * Parameters: wind - wind grid
+ *             buffer - framebuffer the grid is stretched over
+ *             secondsElapsed - animation time step
+ * Side Effects: Rewrites every grid velocity
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+UpdateWindField(WindField *wind, FrameBuffer *buffer, double secondsElapsed) {
+  // Noise cells per grid cell, scroll in noise cells per second, px/s
+  float frequency = 0.35f;
+  float scroll = 0.15f;
+  float strength = 40.0f;
+  float epsilon = 0.25f;
+
+  wind->time += secondsElapsed;
+  wind->cellsPerPixelX = (float)WIND_GRID_WIDTH / buffer->width;
+  wind->cellsPerPixelY = (float)WIND_GRID_HEIGHT / buffer->height;
+
+  float offsetX = (float)(wind->time * scroll);
+  float offsetY = (float)(wind->time * scroll * 0.3f);
+  for(int y = 0; y <= WIND_GRID_HEIGHT; y++) {
+    for(int x = 0; x <= WIND_GRID_WIDTH; x++) {
+      float noiseX = x * frequency - offsetX;
+      float noiseY = y * frequency + offsetY;
+
+      // Central differences of the noise potential
+      float dx = ValueNoise(noiseX + epsilon, noiseY) - ValueNoise(noiseX - epsilon, noiseY);
+      float dy = ValueNoise(noiseX, noiseY + epsilon) - ValueNoise(noiseX, noiseY - epsilon);
+      float scale = strength / (2 * epsilon);
+      wind->velX[y][x] = dy * scale;
+      wind->velY[y][x] = -dx * scale;
+    }
+  }
+
+  for(int y = 0; y < WIND_GRID_HEIGHT; y++) {
+    for(int x = 0; x < WIND_GRID_WIDTH; x++) {
+      WindCell *cell = &wind->cells[y][x];
+      cell->velX[0] = wind->velX[y][x];
+      cell->velX[1] = wind->velX[y][x + 1] - wind->velX[y][x];
+      cell->velX[2] = wind->velX[y + 1][x] - wind->velX[y][x];
+      cell->velX[3] = wind->velX[y + 1][x + 1] - wind->velX[y + 1][x] - cell->velX[1];
+      cell->velY[0] = wind->velY[y][x];
+      cell->velY[1] = wind->velY[y][x + 1] - wind->velY[y][x];
+      cell->velY[2] = wind->velY[y + 1][x] - wind->velY[y][x];
+      cell->velY[3] = wind->velY[y + 1][x + 1] - wind->velY[y + 1][x] - cell->velY[1];
+    }
+  }
+}
+
+/*
+ * Function Name: SampleWindField
+ * Description: Bilinear wind lookup at every particle, in one pass ahead of
+ *              the simulation loop. Positions are clamped to the grid rather
+ *              than skipping free or settled particles, so the loop has no
+ *              branches and its weights vectorize
+ * Parameters: wind - wind grid
+ *             particles - particle store
+ *             count - particle store length
+ *             velX - sampled horizontal velocity per particle
+ *             velY - sampled vertical velocity per particle
+ * Side Effects: N/A
+ * Error Conditions: Free particles hold a list index in x, their samples
+ *                   are meaningless but stay in the grid
  * Return Value: N/A
  */
 internal void
-DrawParticle(FrameBuffer *buffer, Particle *p) {
-  Color c = GetColor(p->color);
-  FillRect(buffer, p->x - p->radius, p->y - p->radius, p->x + p->radius, p->y + p->radius, c);
+SampleWindField(WindField *wind, Particle *particles, uint32_t count, float *velX, float *velY) {
+  for(uint32_t i = 0; i < count; i++) {
+    Particle *p = particles + i;
+    // NaN positions fall to 0 through Max
+    float gridX = Min(Max(p->x * wind->cellsPerPixelX, 0.0f), WIND_GRID_WIDTH - 0.001f);
+    float gridY = Min(Max(p->y * wind->cellsPerPixelY, 0.0f), WIND_GRID_HEIGHT - 0.001f);
+    int cellX = (int)gridX;
+    int cellY = (int)gridY;
+    float fx = gridX - cellX;
+    float fy = gridY - cellY;
+
+    WindCell *cell = &wind->cells[cellY][cellX];
+    velX[i] = cell->velX[0] + fx * cell->velX[1] + fy * (cell->velX[2] + fx * cell->velX[3]);
+    velY[i] = cell->velY[0] + fx * cell->velY[1] + fy * (cell->velY[2] + fx * cell->velY[3]);
+  }
 }
 
 /*
  * Function Name: InitParticle
  * Description: Initialize particle
- * Parameters: buffer - framebuffer
+ * Parameters: random - scene random sequence
+ *             buffer - framebuffer
  *             p - particle
- * Side Effects: N/A
+ * Side Effects: Advances the random sequence
  * Error Conditions: N/A
  * Return Value: N/A
  */
 internal void
-InitParticle(FrameBuffer *buffer, Particle *p) {
+InitParticle(RandomSeries *random, FrameBuffer *buffer, Particle *p) {
   // Z depth must go first
-  p->z = RandomPercent();
-  p->radius = 2.5f + 2 * p->z;
-  p->x = Random() % buffer->width;
-  p->y = -2 * p->radius;
+  p->z = Random(random) & 0xff;
+  p->x = Random(random) % buffer->width;
+  p->y = -2 * GetParticleRadius(p);
 
   p->velX = 0;
-  p->velY = 100;
-  p->targetVelX = p->velX;
-  p->targetVelY = p->velY;
-  p->lerp = 1;
-  p->lerpSpeed = 0.01;
-
-  double hue = RandomPercent();
-  p->color.a = 0.25 + 0.75 * p->z;
-  p->color.r = Lerp(0.3f, 0.5f, hue);
-  p->color.g = Lerp(0.9f, 0.5f, hue);
-  p->color.b = Lerp(1.0f, 1.0f, hue);
+  p->velY = PARTICLE_FALL_SPEED;
+
+  p->color = Random(random) % PARTICLE_PALETTE_SIZE;
+  p->settled = 0;
   p->lifetime = 600;
 }
 
@@ -60,105 +174,722 @@ InitParticle(FrameBuffer *buffer, Particle *p) {
  * Function Name: AnimateParticle
  * Description: Update particle state
  * Parameters: p - particle
+ *             windX - horizontal wind at the particle
+ *             windY - vertical wind at the particle
+ *             response - share of the gap to the wind closed this frame
  *             secondsElapsed - animation time step
- * Side Effects: Render particle to framebuffer
+ * Side Effects: Moves the particle
  * Error Conditions: N/A
  * Return Value: N/A
  */
-internal void
-AnimateParticle(Particle *p, double secondsElapsed) {
-  // Perterbations
-  if(RandomPercent() > 0.95 && p->lerp > 0.7) {
-
-    // Compound with gravity
-    p->startVelX = p->velX;
-    p->startVelY = p->velY;
-
-    p->targetVelX = 20 * (0.5 - RandomPercent());
-    p->targetVelY = p->velY + 10 * (0.5 - RandomPercent());
-
-    p->lerp = 0;
+inline internal void
+AnimateParticle(Particle *p, float windX, float windY, float response, float secondsElapsed) {
+  if(p->settled) {
+    p->lifetime--;
+    return;
   }
 
-  // Acceleration
-  p->velX = Lerp(p->targetVelX, p->startVelX, p->lerp);
-  p->velY = Lerp(p->targetVelY, p->startVelY, p->lerp);
-  p->lerp = (p->lerp > 1) ? 1 : p->lerp + p->lerpSpeed;
+  // Acceleration, drag eases the flake toward falling with the wind
+  p->velX += (windX - p->velX) * response;
+  p->velY += (PARTICLE_FALL_SPEED + windY - p->velY) * response;
 
   // Velocity
-  p->x += p->velX * secondsElapsed * (0.5 + 0.5 * p->z);
-  p->y += p->velY * secondsElapsed * (0.5 + 0.5 * p->z);
+  float depthSpeed = (0.5f + 0.5f * GetParticleDepth(p)) * secondsElapsed;
+  p->x += p->velX * depthSpeed;
+  p->y += p->velY * depthSpeed;
   p->lifetime--;
 }
 
 
 /*
- * Function Name: UpdateAndRender
- * Description: Manage particle state and display
- * Parameters: memory - system allocated storage
- *             buffer - framebuffer
+ * Function Name: FreeParticle
+ * Description: Retire a particle to the free list
+ * Parameters: state - application state
+ *             index - particle index
+ * Side Effects: Particle may be respawned
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+FreeParticle(State *state, uint32_t index) {
+  Particle *p = state->particles + index;
+  p->next = state->availableParticle;
+  state->availableParticle = index;
+  p->lifetime = 0;
+}
+
+/*
+ * Function Name: SettleParticles
+ * Description: Stop falling flakes whose bottom edge crossed the top of an
+ *              obstacle this frame. Flakes blown into its sides or rising
+ *              under it pass by
+ * Parameters: state - application state, grid built this frame
  *             secondsElapsed - animation time step
- * Side Effects: Updates and Renders particles
+ *             maxVelY - fastest downward velocity of any flake this frame
+ * Side Effects: Settled flakes rest on the obstacle until they expire
  * Error Conditions: N/A
  * Return Value: N/A
  */
 internal void
-UpdateAndRender(Memory *memory, FrameBuffer *buffer, double secondsElapsed) {
-  Assert(sizeof(State) <= memory->size);
-  State *state = (State *)memory->storage;
-  if(!memory->isInitialized) {
-    randomSeed[0] = 0x0bdb1dd352d7ddd4;
-    randomSeed[1] = 0x009b18cd16d1df52;
-  
-    // Link particle free list
-    for(int i = ArrayLength(state->particles) - 2; i >= 0; i--) {
-      Particle *p = state->particles + i;
-      p->next = p + 1;
+SettleParticles(State *state, double secondsElapsed, float maxVelY) {
+  // A flake may have crossed the top anywhere along its fall, so on long
+  // frames the search reaches that far below it
+  float maxFall = Max(maxVelY * (float)secondsElapsed, 0.0f);
+  for(int i = 0; i < state->obstacleCount; i++) {
+    Obstacle *o = state->obstacles + i;
+
+    SpatialQuery query = BeginSpatialQuery(&state->grid, o->minX, o->minY - PARTICLE_MAX_RADIUS,
+                                           o->maxX, o->minY + PARTICLE_MAX_RADIUS + maxFall);
+    uint32_t index;
+    while(NextSpatialQuery(&state->grid, &query, &index)) {
+      Particle *p = state->particles + index;
+      if(p->lifetime == 0 || p->settled || p->velY <= 0 || p->x < o->minX || p->x > o->maxX) {
+        continue;
+      }
+
+      // Distance AnimateParticle moved it down this frame
+      float fall = p->velY * (0.5f + 0.5f * GetParticleDepth(p)) * (float)secondsElapsed;
+      float bottom = p->y + GetParticleRadius(p);
+      if(bottom >= o->minY && bottom - fall <= o->minY) {
+        p->y = o->minY - GetParticleRadius(p);
+        p->velX = 0;
+        p->velY = 0;
+        p->settled = 1;
+      }
     }
-    state->availableParticle = state->particles;
+  }
+}
 
-    memory->isInitialized = true;
+/*
+ * Function Name: MergeParticles
+ * Description: Combine overlapping falling flakes at a similar depth. The
+ *              survivor keeps the total area and the area weighted position
+ *              and velocity
+ * Parameters: state - application state, grid built this frame
+ * Side Effects: Absorbed flakes are freed
+ * Error Conditions: N/A
+ * Return Value: Flakes absorbed
+ */
+internal uint32_t
+MergeParticles(State *state) {
+  uint32_t result = 0;
+  for(uint32_t i = 0; i < ArrayLength(state->particles); i++) {
+    Particle *a = state->particles + i;
+    if(a->lifetime == 0 || a->settled) {
+      continue;
+    }
+
+    float radiusA = GetParticleRadius(a);
+    float reach = radiusA + PARTICLE_MAX_RADIUS;
+    SpatialQuery query = BeginSpatialQuery(&state->grid, a->x - reach, a->y - reach,
+                                           a->x + reach, a->y + reach);
+    uint32_t index;
+    while(NextSpatialQuery(&state->grid, &query, &index)) {
+      // Each pair once
+      Particle *b = state->particles + index;
+      if(index <= i || b->lifetime == 0 || b->settled) {
+        continue;
+      }
+
+      int depthDelta = (int)a->z - (int)b->z;
+      if(depthDelta > PARTICLE_MERGE_DEPTH || depthDelta < -PARTICLE_MERGE_DEPTH) {
+        continue;
+      }
+
+      float radiusB = GetParticleRadius(b);
+      float dx = b->x - a->x;
+      float dy = b->y - a->y;
+      if(dx * dx + dy * dy >= (radiusA + radiusB) * (radiusA + radiusB)) {
+        continue;
+      }
+
+      float areaA = radiusA * radiusA;
+      float areaB = radiusB * radiusB;
+      float weightB = areaB / (areaA + areaB);
+      a->x += dx * weightB;
+      a->y += dy * weightB;
+      a->velX += (b->velX - a->velX) * weightB;
+      a->velY += (b->velY - a->velY) * weightB;
+
+      float radius = sqrtf(areaA + areaB);
+      float depth = (radius - PARTICLE_MIN_RADIUS) / PARTICLE_RADIUS_RANGE;
+      a->z = RoundDoubleToUInt32(Min(depth, 1.0f) * 255.0f);
+      a->lifetime = Max(a->lifetime, b->lifetime);
+      radiusA = GetParticleRadius(a);
+
+      FreeParticle(state, index);
+      result++;
+    }
   }
+  return result;
+}
 
-  // Specifies color for the background
-  DoubleColor background = {1, 0.01, 0.02, 0.05};
-  FillRect(buffer, 0, 0, buffer->width, buffer->height, GetColor(background));
+/*
+ * Function Name: ApplySceneOptions
+ * Description: Take up the options the platform set in memory, scaling
+ *              obstacles to the framebuffer
+ * Parameters: memory - system allocated storage
+ *             state - initialized application state
+ *             buffer - framebuffer
+ * Side Effects: Columns obstacles left in the pack band are redrawn
+ * Error Conditions: Obstacles past MAX_OBSTACLES are ignored
+ * Return Value: N/A
+ */
+internal void
+ApplySceneOptions(Memory *memory, State *state, FrameBuffer *buffer) {
+  state->mergeFlakes = memory->mergeFlakes;
+
+  Obstacle obstacles[MAX_OBSTACLES];
+  int obstacleCount = Min(Max(memory->obstacleCount, 0), MAX_OBSTACLES);
+  for(int i = 0; i < obstacleCount; i++) {
+    Obstacle *o = memory->obstacles + i;
+    obstacles[i].minX = o->minX * buffer->width;
+    obstacles[i].minY = o->minY * buffer->height;
+    obstacles[i].maxX = o->maxX * buffer->width;
+    obstacles[i].maxY = o->maxY * buffer->height;
+  }
+
+  if(obstacleCount == state->obstacleCount &&
+     memcmp(obstacles, state->obstacles, obstacleCount * sizeof(Obstacle)) == 0) {
+    return;
+  }
+
+  // The band keeps pixels of columns that don't change, UpdateScene marks
+  // the new positions
+  uint32_t tick = (uint32_t)state->ticks;
+  int bandTop = Max(buffer->height - state->snowpack.bandHeight, 0);
+  for(int i = 0; i < state->obstacleCount; i++) {
+    Obstacle *o = state->obstacles + i;
+    if(o->maxY >= bandTop) {
+      MarkSnowpackColumns(&state->snowpack, buffer, FloorFloatToInt32(o->minX),
+                          FloorFloatToInt32(o->maxX), tick);
+    }
+  }
+  state->obstacleCount = obstacleCount;
+  memcpy(state->obstacles, obstacles, obstacleCount * sizeof(Obstacle));
+}
+
+/*
+ * Function Name: UpdateScene
+ * Description: Advance particle state one frame. Leaves the state read-only
+ *              for RenderScene so the frame can be drawn in parallel bands
+ * Parameters: state - initialized application state
+ *             buffer - framebuffer
+ *             secondsElapsed - animation time step
+ *             counters - frame counts, added to
+ * Side Effects: Updates particles, advances ticks
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+UpdateScene(State *state, FrameBuffer *buffer, double secondsElapsed, FrameCounters *counters) {
+  uint32_t tick = (uint32_t)state->ticks;
+  UpdateWindField(&state->wind, buffer, secondsElapsed);
 
   // Particle spawning
   // TODO constant particle density?
   if(state->ticks % 2 == 0) {
-    Particle *p = state->availableParticle;
-    if(p) {
+    uint32_t index = state->availableParticle;
+    if(index != PARTICLE_NONE) {
+      Particle *p = state->particles + index;
       state->availableParticle = p->next;
-      InitParticle(buffer, p);
+      InitParticle(&state->random, buffer, p);
+      counters->spawns++;
+    }
+    else {
+      counters->spawnFailures++;
     }
     // TODO Currently, particles fail to spawn if none are available. Possibly
     // look into reducing lifetimes of existing particles or cull at higher
     // threshold
   }
 
-  // Simulate and draw particles
-  for(size_t i = 0; i < ArrayLength(state->particles); i++) {
+  // Simulate particles
+  float windX[MAX_PARTICLES];
+  float windY[MAX_PARTICLES];
+  SampleWindField(&state->wind, state->particles, ArrayLength(state->particles), windX, windY);
+  float response = Min((float)(PARTICLE_WIND_RESPONSE * secondsElapsed), 1.0f);
+  float maxVelY = 0;
+  for(uint32_t i = 0; i < ArrayLength(state->particles); i++) {
     Particle *p = state->particles + i;
-    
-    // TODO Die early if they leave the screen
-
-    // Particles fade out as they near end
-    if(p->lifetime != 0 && p->lifetime < 20) {
-      p->color.a *= 0.8;
+    if(p->lifetime == 0) {
+      continue;
     }
 
+    // TODO Die early if they leave the screen
+
     // Add to free list
-    if(p->lifetime != 0 && p->lifetime <= 1) {
-      p->next = state->availableParticle;
-      state->availableParticle = p;
-      p->lifetime = 0;
+    if(p->lifetime <= 1) {
+      FreeParticle(state, i);
+      counters->culls++;
     }
     else {
-      AnimateParticle(p, secondsElapsed);
-      DrawParticle(buffer, p);
+      AnimateParticle(p, windX[i], windY[i], response, (float)secondsElapsed);
+      maxVelY = Max(maxVelY, p->velY);
+
+      // Landed flakes become part of the pack
+      if(!p->settled && DepositParticle(&state->snowpack, buffer, p, tick)) {
+        FreeParticle(state, i);
+        counters->landed++;
+      }
+    }
+  }
+  SmoothSnowpack(&state->snowpack, buffer, tick);
+
+  // Interactions
+  RebuildSpatialGrid(&state->grid, state->particles, ArrayLength(state->particles));
+  SettleParticles(state, secondsElapsed, maxVelY);
+  if(state->mergeFlakes) {
+    counters->merged += MergeParticles(state);
+  }
+
+  // Flakes and obstacle edges blend over the band, dirtying its columns for
+  // later frames
+  int bandTop = Max(buffer->height - state->snowpack.bandHeight, 0);
+  for(int i = 0; i < state->obstacleCount; i++) {
+    Obstacle *o = state->obstacles + i;
+    if(o->maxY >= bandTop) {
+      MarkSnowpackColumns(&state->snowpack, buffer, FloorFloatToInt32(o->minX),
+                          FloorFloatToInt32(o->maxX), tick);
+    }
+  }
+  for(uint32_t i = 0; i < ArrayLength(state->particles); i++) {
+    Particle *p = state->particles + i;
+    if(p->lifetime != 0) {
+      counters->liveParticles++;
+      float radius = GetParticleRadius(p);
+      if(p->y + radius >= bandTop) {
+        MarkSnowpackColumns(&state->snowpack, buffer, FloorFloatToInt32(p->x - radius) - 1,
+                            FloorFloatToInt32(p->x + radius) + 1, tick);
+      }
     }
   }
 
   state->ticks++;
 }
+
+/*
+ * Function Name: RenderScene
+ * Description: Draw a band of rows of the frame UpdateScene just advanced.
+ *              Bands of one frame touch disjoint pixels and only read state
+ * Parameters: state - application state
+ *             buffer - framebuffer
+ *             minY - first row
+ *             maxY - row past the end
+ * Side Effects: Writes framebuffer rows minY to maxY
+ * Error Conditions: N/A
+ * Return Value: Pixels blended
+ */
+template<typename Format>
+internal uint64_t
+RenderScene(State *state, FrameBuffer *buffer, int minY, int maxY) {
+  uint32_t tick = (uint32_t)(state->ticks - 1);
+
+  // Specifies color for the background, the pack band draws its own
+  DoubleColor background = {1, 0.01, 0.02, 0.05};
+  DoubleColor snowColor = {1, 0.85, 0.9, 1.0};
+  int bandTop = Max(buffer->height - state->snowpack.bandHeight, 0);
+  FillPixelRect<Format>(buffer, 0, minY, buffer->width, Min(bandTop, maxY), GetColor(background));
+  DrawSnowpack<Format>(&state->snowpack, buffer, minY, maxY, GetColor(background), GetColor(snowColor), tick);
+
+  // Rect fills clip to the band view, in coordinates relative to its top row
+  FrameBuffer band = *buffer;
+  band.bitmap = GetPixel(buffer, 0, minY);
+  band.height = maxY - minY;
+  double originY = minY;
+
+  uint64_t result = 0;
+  DoubleColor obstacleColor = {1, 0.05, 0.06, 0.1};
+  for(int i = 0; i < state->obstacleCount; i++) {
+    Obstacle *o = state->obstacles + i;
+    result += FillRect<Format>(&band, o->minX, o->minY - originY, o->maxX, o->maxY - originY, GetColor(obstacleColor));
+  }
+
+  // Draw particles
+  for(uint32_t i = 0; i < ArrayLength(state->particles); i++) {
+    Particle *p = state->particles + i;
+    if(p->lifetime != 0) {
+      result += DrawParticle<Format>(&band, state->palette, p, originY);
+    }
+  }
+  return result;
+}
+
+/*
+ * Function Name: RenderSceneRows
+ * Description: Pick the RenderScene kernels for the framebuffer format
+ * Parameters: state - application state
+ *             buffer - framebuffer
+ *             minY - first row
+ *             maxY - row past the end
+ * Side Effects: Writes framebuffer rows minY to maxY
+ * Error Conditions: N/A
+ * Return Value: Pixels blended
+ */
+internal uint64_t
+RenderSceneRows(State *state, FrameBuffer *buffer, int minY, int maxY) {
+  uint64_t result;
+
+  // Kernels are picked once per band rather than per pixel
+  Assert(buffer->pixelBytes == GetPixelFormatBytes(buffer->format));
+  switch(buffer->format) {
+    case PixelFormat_RGBA8888: {
+      result = RenderScene<FormatRGBA8888>(state, buffer, minY, maxY);
+    } break;
+
+    case PixelFormat_RGB565: {
+      result = RenderScene<FormatRGB565>(state, buffer, minY, maxY);
+    } break;
+
+    case PixelFormat_Gray8: {
+      result = RenderScene<FormatGray8>(state, buffer, minY, maxY);
+    } break;
+
+    case PixelFormat_BGRA8888:
+    default: {
+      result = RenderScene<FormatBGRA8888>(state, buffer, minY, maxY);
+    } break;
+  }
+  return result;
+}
+
+/*
+ * Function Name: UpdateSceneTimed
+ * Description: UpdateScene with the platform's current options, publishing
+ *              its counts and duration
+ * Parameters: memory - system allocated storage
+ *             state - initialized application state
+ *             buffer - framebuffer
+ *             secondsElapsed - animation time step
+ *             threadIndex - pool thread running the caller
+ * Side Effects: Updates particles, adds to the thread's stats slot
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+UpdateSceneTimed(Memory *memory, State *state, FrameBuffer *buffer, double secondsElapsed, int threadIndex) {
+  StatsSlot *slot = GetStatsSlot(memory, threadIndex);
+  uint64_t start = BeginStatsTimer(memory);
+
+  FrameCounters counters = {};
+  ApplySceneOptions(memory, state, buffer);
+  UpdateScene(state, buffer, secondsElapsed, &counters);
+
+  EndStatsTimer(memory, slot, StatsPhase_Update, start);
+  AddFrameCounters(slot, &counters);
+
+  // Scenes may run on a different thread each frame, so only the change in
+  // their count goes to this thread's slot
+  if(slot) {
+    StatsAdd(&slot->liveParticles, (uint64_t)counters.liveParticles - memory->publishedLiveParticles);
+  }
+  memory->publishedLiveParticles = counters.liveParticles;
+}
+
+/*
+ * Function Name: RenderSceneTimed
+ * Description: RenderSceneRows, publishing its pixel count and duration
+ * Parameters: memory - system allocated storage
+ *             state - application state
+ *             buffer - framebuffer
+ *             minY - first row
+ *             maxY - row past the end
+ *             threadIndex - pool thread running the caller
+ * Side Effects: Writes framebuffer rows, adds to the thread's stats slot
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+RenderSceneTimed(Memory *memory, State *state, FrameBuffer *buffer, int minY, int maxY, int threadIndex) {
+  StatsSlot *slot = GetStatsSlot(memory, threadIndex);
+  uint64_t start = BeginStatsTimer(memory);
+
+  uint64_t pixels = RenderSceneRows(state, buffer, minY, maxY);
+
+  EndStatsTimer(memory, slot, StatsPhase_Render, start);
+  if(slot) {
+    StatsAdd(&slot->pixelsBlended, pixels);
+  }
+}
+
+/*
+ * Function Name: GetStateLayout
+ * Description: FNV-1a hash of State's size, the limits that shape its arrays
+ *              and STATE_VERSION
+ * Parameters: N/A
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Layout hash
+ */
+internal uint32_t
+GetStateLayout(void) {
+  uint32_t fields[] = {
+    (uint32_t)sizeof(State),
+    (uint32_t)sizeof(Particle),
+    MAX_PARTICLES,
+    MAX_OBSTACLES,
+    SPATIAL_GRID_BUCKETS,
+    WIND_GRID_WIDTH,
+    WIND_GRID_HEIGHT,
+    STATE_VERSION,
+  };
+  uint32_t result = 2166136261u;
+  for(uint32_t i = 0; i < ArrayLength(fields); i++) {
+    result = (result ^ fields[i]) * 16777619u;
+  }
+  return result;
+}
+
+/*
+ * Function Name: GetSceneState
+ * Description: Application state in memory, initialized on first use or
+ *              when a reloaded library changed its layout
+ * Parameters: memory - system allocated storage
+ *             seed - random sequence for a new state
+ * Side Effects: Initializes memory
+ * Error Conditions: Returns 0 if State has outgrown memory, a reloaded
+ *                   library may be built with larger limits than the platform
+ *                   reserved for
+ * Return Value: Result
+ */
+internal State *
+GetSceneState(Memory *memory, uint64_t seed) {
+  if(!memory->storage || sizeof(State) > memory->size) {
+    return 0;
+  }
+
+  State *state = (State *)memory->storage;
+  uint32_t layout = GetStateLayout();
+  if(!memory->isInitialized || state->size != sizeof(State) || state->layout != layout) {
+    memset(state, 0, sizeof(State));
+    state->size = sizeof(State);
+    state->layout = layout;
+    SeedRandom(&state->random, seed);
+
+    // Link particle free list
+    for(uint32_t i = 0; i < ArrayLength(state->particles); i++) {
+      Particle *p = state->particles + i;
+      p->next = (i + 1 < ArrayLength(state->particles)) ? i + 1 : PARTICLE_NONE;
+    }
+    state->availableParticle = 0;
+    InitPalette(state->palette);
+
+    memory->isInitialized = true;
+  }
+  return state;
+}
+
+/*
+ * Function Name: UpdateAndRender
+ * Description: Manage particle state and display
+ * Parameters: memory - system allocated storage
+ *             buffer - framebuffer
+ *             secondsElapsed - animation time step
+ * Side Effects: Updates and Renders particles
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+extern "C"
+UPDATE_AND_RENDER(UpdateAndRender) {
+  State *state = GetSceneState(memory, 0);
+  if(!state) {
+    local_persist bool reported;
+    if(!reported) {
+      DEBUGPRINT("State needs %zu bytes, memory has %zu, skipping frames\n", sizeof(State), memory->size);
+      reported = true;
+    }
+    return;
+  }
+
+  UpdateSceneTimed(memory, state, buffer, secondsElapsed, 0);
+  RenderSceneTimed(memory, state, buffer, 0, buffer->height, 0);
+}
+
+// Work items stay alive until the queue drains, so a batch larger than this
+// is scheduled in several rounds
+#define SCENE_MAX_WORK_ITEMS 128
+// Splitting finer than this costs more in per item overhead than it gains
+#define SCENE_MIN_WORK_PIXELS (256 * 256)
+// Items per thread, slack for scenes of uneven cost
+#define SCENE_WORK_ITEMS_PER_THREAD 4
+
+struct SceneWork {
+  Scene *scenes;
+  int sceneCount;
+  // Rows of a single split scene, packed scenes are drawn whole
+  int minY;
+  int maxY;
+  double secondsElapsed;
+};
+
+/*
+ * Function Name: UpdateScenesWork
+ * Description: Work queue entry advancing a run of scenes
+ * Parameters: queue - work queue
+ *             data - SceneWork
+ *             threadIndex - pool thread running the entry
+ * Side Effects: Updates scene state
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal
+PLATFORM_WORK_QUEUE_CALLBACK(UpdateScenesWork) {
+  SceneWork *work = (SceneWork *)data;
+  for(int i = 0; i < work->sceneCount; i++) {
+    Scene *scene = work->scenes + i;
+    State *state = GetSceneState(&scene->memory, scene->seed);
+    if(!state) {
+      continue;
+    }
+    UpdateSceneTimed(&scene->memory, state, &scene->buffer, work->secondsElapsed, threadIndex);
+  }
+}
+
+/*
+ * Function Name: RenderScenesWork
+ * Description: Work queue entry drawing packed scenes or a band of one
+ * Parameters: queue - work queue
+ *             data - SceneWork
+ *             threadIndex - pool thread running the entry
+ * Side Effects: Writes framebuffer rows
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal
+PLATFORM_WORK_QUEUE_CALLBACK(RenderScenesWork) {
+  SceneWork *work = (SceneWork *)data;
+  for(int i = 0; i < work->sceneCount; i++) {
+    Scene *scene = work->scenes + i;
+    // Scenes whose update was skipped have no state to draw
+    if(!scene->memory.storage || sizeof(State) > scene->memory.size) {
+      continue;
+    }
+    State *state = (State *)scene->memory.storage;
+    int maxY = Min(work->maxY, scene->buffer.height);
+    RenderSceneTimed(&scene->memory, state, &scene->buffer, work->minY, maxY, threadIndex);
+  }
+}
+
+/*
+ * Function Name: RunSceneWork
+ * Description: Queue work items, or run them here without a pool
+ * Parameters: work - platform thread pool, may be 0
+ *             callback - entry to run per item
+ *             items - work items
+ *             itemCount - work item count
+ * Side Effects: Every item has completed on return
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+RunSceneWork(PlatformWork *work, PlatformWorkQueueCallback *callback, SceneWork *items, int itemCount) {
+  if(!work) {
+    for(int i = 0; i < itemCount; i++) {
+      callback(0, items + i, 0);
+    }
+    return;
+  }
+
+  for(int i = 0; i < itemCount; i++) {
+    work->addEntry(work->queue, callback, items + i);
+  }
+  work->completeAllWork(work->queue);
+}
+
+/*
+ * Function Name: UpdateAndRenderScenes
+ * Description: Advance independent scenes one frame across a thread pool.
+ *              Every scene updates first, then rendering is divided into
+ *              items of similar pixel counts: small scenes are packed into
+ *              one item, large ones are split into row bands
+ * Parameters: scenes - scenes to advance
+ *             sceneCount - scene count
+ *             secondsElapsed - animation time step
+ *             work - platform thread pool, 0 runs on the calling thread
+ * Side Effects: Updates and Renders every scene
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+extern "C"
+UPDATE_AND_RENDER_SCENES(UpdateAndRenderScenes) {
+  if(sceneCount <= 0) {
+    return;
+  }
+
+  int threadCount = work ? Max(work->threadCount, 1) : 1;
+  int targetItems = threadCount * SCENE_WORK_ITEMS_PER_THREAD;
+  SceneWork items[SCENE_MAX_WORK_ITEMS];
+  int itemCount = 0;
+
+  // Updates cost about the same per scene, so runs of equal length
+  int scenesPerItem = (sceneCount + targetItems - 1) / targetItems;
+  for(int first = 0; first < sceneCount; first += scenesPerItem) {
+    if(itemCount == SCENE_MAX_WORK_ITEMS) {
+      RunSceneWork(work, UpdateScenesWork, items, itemCount);
+      itemCount = 0;
+    }
+    SceneWork *item = items + itemCount++;
+    item->scenes = scenes + first;
+    item->sceneCount = Min(scenesPerItem, sceneCount - first);
+    item->secondsElapsed = secondsElapsed;
+  }
+  RunSceneWork(work, UpdateScenesWork, items, itemCount);
+  itemCount = 0;
+
+  // Rendering cost follows pixel count
+  int64_t totalPixels = 0;
+  for(int i = 0; i < sceneCount; i++) {
+    totalPixels += (int64_t)scenes[i].buffer.width * scenes[i].buffer.height;
+  }
+  int64_t targetPixels = Max(totalPixels / targetItems, (int64_t)SCENE_MIN_WORK_PIXELS);
+
+  int packFirst = 0;
+  int64_t packPixels = 0;
+  for(int i = 0; i <= sceneCount; i++) {
+    int64_t pixels = 0;
+    if(i < sceneCount) {
+      pixels = (int64_t)scenes[i].buffer.width * scenes[i].buffer.height;
+    }
+
+    // Close the pack before a scene that gets split, once it is big enough,
+    // or at the end
+    bool split = (pixels >= targetPixels);
+    if(packFirst < i && (split || i == sceneCount || packPixels + pixels > targetPixels)) {
+      if(itemCount == SCENE_MAX_WORK_ITEMS) {
+        RunSceneWork(work, RenderScenesWork, items, itemCount);
+        itemCount = 0;
+      }
+      SceneWork *item = items + itemCount++;
+      item->scenes = scenes + packFirst;
+      item->sceneCount = i - packFirst;
+      item->minY = 0;
+      item->maxY = INT32_MAX;
+      packFirst = i;
+      packPixels = 0;
+    }
+    if(i == sceneCount) {
+      break;
+    }
+
+    if(split) {
+      FrameBuffer *buffer = &scenes[i].buffer;
+      int bandCount = (int)Min((pixels + targetPixels - 1) / targetPixels, (int64_t)buffer->height);
+      for(int band = 0; band < bandCount; band++) {
+        if(itemCount == SCENE_MAX_WORK_ITEMS) {
+          RunSceneWork(work, RenderScenesWork, items, itemCount);
+          itemCount = 0;
+        }
+        SceneWork *item = items + itemCount++;
+        item->scenes = scenes + i;
+        item->sceneCount = 1;
+        item->minY = (int)((int64_t)buffer->height * band / bandCount);
+        item->maxY = (int)((int64_t)buffer->height * (band + 1) / bandCount);
+      }
+      packFirst = i + 1;
+    }
+    else {
+      packPixels += pixels;
+    }
+  }
+  RunSceneWork(work, RenderScenesWork, items, itemCount);
+}
@@ -26,11 +26,16 @@
 
 #if FAST_BUILD
 #define Assert(expr)
-#else
+#elif defined(_WIN32)
 #define Assert(expr) if(!(expr)) { \
                        MessageBox(0, "Error in "__FILE__" on line " TOSTRING(__LINE__) "\nFailed: " TOSTRING(expr), 0, MB_OK); \
                        PostQuitMessage(0);\
                      }
+#else
+#define Assert(expr) if(!(expr)) { \
+                       fprintf(stderr, "Error in " __FILE__ " on line " TOSTRING(__LINE__) "\nFailed: " TOSTRING(expr) "\n"); \
+                       *(volatile int *)0 = 0;\
+                     }
 #endif
 
 #if EXTERNAL_BUILD
@@ -48,32 +53,220 @@
 #define global_variable static
 
 #define ArrayLength(arr) (sizeof(arr) / sizeof(*arr))
+#define AlignPow2(value, alignment) (((value) + ((alignment) - 1)) & ~((alignment) - 1))
+
+// Framebuffer rows start on a cache line
+#define FRAMEBUFFER_ROW_ALIGNMENT 64
+
+#include "stats.h"
+
+// Monotonic clock provided by the platform
+typedef uint64_t PlatformGetNanoseconds();
+
+// Rectangles flakes come to rest on
+struct Obstacle {
+  float minX;
+  float minY;
+  float maxX;
+  float maxY;
+};
+
+#define MAX_OBSTACLES 16
+
+// Storage a platform reserves for each scene. Fixed rather than
+// sizeof(State), so a reloaded library may grow State up to it. Only the
+// pages State covers are touched, the rest is headroom
+#define SNOW_MEMORY_SIZE Megabytes(64)
 
 struct Memory {
   bool isInitialized;
   size_t size;
   void *storage;
+
+  // Counters the platform shares with monitors, 0 to skip collecting them
+  Stats *stats;
+  PlatformGetNanoseconds *getNanoseconds;
+  // Live particles last added to stats, kept here rather than in State so a
+  // reset scene takes its old count back out
+  uint32_t publishedLiveParticles;
+
+  // Scene options the platform may change between frames. Obstacles are in
+  // fractions of the framebuffer so they follow resizes
+  int obstacleCount;
+  Obstacle obstacles[MAX_OBSTACLES];
+  // Overlapping flakes at a similar depth combine into one larger flake
+  bool mergeFlakes;
 };
 
+/*
+ * Function Name: SetDefaultObstacles
+ * Description: Ledges across the middle of the frame for flakes to settle on
+ * Parameters: memory - system allocated storage
+ * Side Effects: Replaces the scene's obstacles
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+inline internal void
+SetDefaultObstacles(Memory *memory) {
+  Obstacle ledges[] = {
+    {0.12f, 0.40f, 0.34f, 0.42f},
+    {0.58f, 0.55f, 0.86f, 0.57f},
+    {0.30f, 0.72f, 0.48f, 0.74f},
+  };
+  memory->obstacleCount = ArrayLength(ledges);
+  for(int i = 0; i < memory->obstacleCount; i++) {
+    memory->obstacles[i] = ledges[i];
+  }
+}
+
+// Byte order of a pixel in memory, pixelBytes must agree
+enum PixelFormat {
+  PixelFormat_BGRA8888, // 32-bit little endian argb, Windows DIB layout
+  PixelFormat_RGBA8888,
+  PixelFormat_RGB565,
+  PixelFormat_Gray8,
+};
+
+/*
+ * Function Name: GetPixelFormatBytes
+ * Description: Bytes per pixel of a framebuffer format
+ * Parameters: format - pixel layout
+ * Side Effects: N/A
+ * Error Conditions: Unknown formats report 4 bytes
+ * Return Value: Result
+ */
+inline internal int
+GetPixelFormatBytes(PixelFormat format) {
+  switch(format) {
+    case PixelFormat_RGB565: return 2;
+    case PixelFormat_Gray8: return 1;
+    case PixelFormat_BGRA8888:
+    case PixelFormat_RGBA8888:
+    default: return 4;
+  }
+}
+
 struct FrameBuffer {
   void *bitmap;
   int width;
   int height;
   int pitch;
   int pixelBytes;
+  PixelFormat format;
+
+  // Frames since this bitmap was last drawn by UpdateAndRender, so cached
+  // layers know which of their changes it is missing. 0 means its contents
+  // are unknown (new or resized) and everything is redrawn
+  int age;
 };
 
-// Services provided to the platform
-internal void UpdateAndRender(Memory *memory, FrameBuffer *buffer, double secondsElapsed);
+// Independent output advanced by UpdateAndRenderScenes, with its own storage
+// and random sequence
+struct Scene {
+  Memory memory;
+  FrameBuffer buffer;
+  // Picks the random sequence when memory is first initialized, 0 is the
+  // sequence UpdateAndRender uses
+  uint64_t seed;
+};
+
+// Thread pool provided by the platform. Entries may run in any order on any
+// worker, CompleteAllWork returns once every added entry has finished.
+// threadIndex is below threadCount and unique among running entries, the
+// thread calling CompleteAllWork is 0
+struct PlatformWorkQueue;
+#define PLATFORM_WORK_QUEUE_CALLBACK(name) void name(PlatformWorkQueue *queue, void *data, int threadIndex)
+typedef PLATFORM_WORK_QUEUE_CALLBACK(PlatformWorkQueueCallback);
+
+typedef void PlatformAddEntry(PlatformWorkQueue *queue, PlatformWorkQueueCallback *callback, void *data);
+typedef void PlatformCompleteAllWork(PlatformWorkQueue *queue);
+
+struct PlatformWork {
+  PlatformWorkQueue *queue;
+  int threadCount;
+  PlatformAddEntry *addEntry;
+  PlatformCompleteAllWork *completeAllWork;
+};
+
+// Services provided to the platform, exported unmangled so a platform can
+// load them from a shared library and reload it while running. Memory is
+// the only state kept between calls
+#define UPDATE_AND_RENDER(name) void name(Memory *memory, FrameBuffer *buffer, double secondsElapsed)
+typedef UPDATE_AND_RENDER(UpdateAndRenderFunc);
+// Work may be 0 to advance the scenes on the calling thread
+#define UPDATE_AND_RENDER_SCENES(name) void name(Scene *scenes, int sceneCount, double secondsElapsed, PlatformWork *work)
+typedef UPDATE_AND_RENDER_SCENES(UpdateAndRenderScenesFunc);
 
 // Application structures
 #include "render.h"
 
+// Wind is a coarse grid of velocities stretched over the framebuffer,
+// sampled bilinearly at each particle
+#define WIND_GRID_WIDTH 16
+#define WIND_GRID_HEIGHT 16
+
+// Bilinear terms of one grid cell, vel = v[0] + fx * v[1] + fy * (v[2] + fx * v[3])
+struct WindCell {
+  float velX[4];
+  float velY[4];
+};
+
+struct WindField {
+  double time;
+  float cellsPerPixelX;
+  float cellsPerPixelY;
+  float velX[WIND_GRID_HEIGHT + 1][WIND_GRID_WIDTH + 1];
+  float velY[WIND_GRID_HEIGHT + 1][WIND_GRID_WIDTH + 1];
+  // Corner velocities folded per cell, so a sample reads 32 contiguous bytes
+  WindCell cells[WIND_GRID_HEIGHT][WIND_GRID_WIDTH];
+};
+
+// Size >= particle lifetime/spawn rate
+#define MAX_PARTICLES 600
+
+#include "spatial.h"
+
+// Snow that has landed, a height per framebuffer column. Only the band of rows
+// the pack can reach is redrawn incrementally, the rest of the frame is not
+#define SNOWPACK_MAX_WIDTH 8192
+
+struct Snowpack {
+  float height[SNOWPACK_MAX_WIDTH];
+  // Frame a column's pixels last changed, from the pack or a flake drawn over it
+  uint32_t changedTick[SNOWPACK_MAX_WIDTH];
+  // Rows above the bottom redrawn per column, only grows
+  int bandHeight;
+  uint32_t bandChangedTick;
+};
+
+// xoroshiro128+ state, see Random
+struct RandomSeries {
+  uint64_t state[2];
+};
+
+// Bump when State's fields change order or meaning, a change the size and
+// limits mixed into its layout hash would not show
+#define STATE_VERSION 1
+
 struct State {
+  // sizeof(State) and GetStateLayout when initialized, a reloaded library
+  // with a different layout starts the scene over rather than misreading it
+  uint32_t size;
+  uint32_t layout;
   uint64_t ticks;
-  Particle *availableParticle;
-  // Size >= particle lifetime/spawn rate
-  Particle particles[600]; 
+  RandomSeries random;
+  uint32_t availableParticle;
+  Color palette[PARTICLE_PALETTE_SIZE];
+  WindField wind;
+
+  // Memory's options in pixels, as of the last update
+  int obstacleCount;
+  Obstacle obstacles[MAX_OBSTACLES];
+  bool mergeFlakes;
+
+  SpatialGrid grid;
+  Snowpack snowpack;
+  Particle particles[MAX_PARTICLES];
 };
 
 #endif /* SNOW_H */
@@ -0,0 +1,193 @@
+/*
+ * Filename: snowpack.cpp
+ * Author: Kevin Hine
+ * Description: Accumulated snow along the bottom of the frame
+ * Date: Oct 18 2026
+ */
+
+// Share of a landing flake's area packed into the columns beneath it
+#define SNOWPACK_DEPOSIT 0.5f
+// Pack never rises above this share of the frame
+#define SNOWPACK_MAX_FRACTION 0.25f
+// Frames between smoothing passes, and the steepest slope they leave in
+// pixels per column
+#define SNOWPACK_SMOOTH_INTERVAL 30
+#define SNOWPACK_MAX_SLOPE 1.5f
+
+/*
+ * Function Name: GetSnowpackColumns
+ * Description: Columns of the framebuffer the pack covers
+ * Parameters: buffer - framebuffer
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Result
+ */
+inline internal int
+GetSnowpackColumns(FrameBuffer *buffer) {
+  int result = Min(buffer->width, SNOWPACK_MAX_WIDTH);
+  return result;
+}
+
+/*
+ * Function Name: MarkSnowpackColumns
+ * Description: Flag columns whose band pixels changed this frame
+ * Parameters: pack - snowpack
+ *             buffer - framebuffer
+ *             minX - first column
+ *             maxX - last column, inclusive
+ *             tick - current frame
+ * Side Effects: Columns are redrawn into buffers missing this frame
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+MarkSnowpackColumns(Snowpack *pack, FrameBuffer *buffer, int minX, int maxX, uint32_t tick) {
+  minX = Max(minX, 0);
+  maxX = Min(maxX, GetSnowpackColumns(buffer) - 1);
+  for(int x = minX; x <= maxX; x++) {
+    pack->changedTick[x] = tick;
+  }
+}
+
+/*
+ * Function Name: DepositParticle
+ * Description: Land a flake that has reached the pack surface
+ * Parameters: pack - snowpack
+ *             buffer - framebuffer
+ *             p - particle
+ *             tick - current frame
+ * Side Effects: Raises the columns beneath the flake
+ * Error Conditions: N/A
+ * Return Value: True if the flake landed and should be retired
+ */
+internal bool
+DepositParticle(Snowpack *pack, FrameBuffer *buffer, Particle *p, uint32_t tick) {
+  int columns = GetSnowpackColumns(buffer);
+  int x = FloorFloatToInt32(p->x);
+  if(x < 0 || x >= columns) {
+    return false;
+  }
+
+  float radius = GetParticleRadius(p);
+  if(p->y + radius < buffer->height - pack->height[x]) {
+    return false;
+  }
+
+  // Spread over the flake's full width, columns off the edge are lost
+  int minX = FloorFloatToInt32(p->x - radius);
+  int maxX = FloorFloatToInt32(p->x + radius);
+  float amount = SNOWPACK_DEPOSIT * 3.14159265f * radius * radius / (maxX - minX + 1);
+  minX = Max(minX, 0);
+  maxX = Min(maxX, columns - 1);
+  float maxHeight = buffer->height * SNOWPACK_MAX_FRACTION;
+  float tallest = 0;
+  for(int c = minX; c <= maxX; c++) {
+    pack->height[c] = Min(pack->height[c] + amount, maxHeight);
+    tallest = Max(tallest, pack->height[c]);
+  }
+  MarkSnowpackColumns(pack, buffer, minX, maxX, tick);
+
+  // Band reaches the tallest column plus its partially covered surface pixel
+  int bandHeight = (int)tallest + 2;
+  if(bandHeight > pack->bandHeight) {
+    pack->bandHeight = bandHeight;
+    pack->bandChangedTick = tick;
+  }
+  return true;
+}
+
+/*
+ * Function Name: SmoothSnowpack
+ * Description: Slide snow off slopes steeper than SNOWPACK_MAX_SLOPE, run
+ *              every SNOWPACK_SMOOTH_INTERVAL frames
+ * Parameters: pack - snowpack
+ *             buffer - framebuffer
+ *             tick - current frame
+ * Side Effects: Moves height between neighbouring columns
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+SmoothSnowpack(Snowpack *pack, FrameBuffer *buffer, uint32_t tick) {
+  if(tick % SNOWPACK_SMOOTH_INTERVAL != 0) {
+    return;
+  }
+
+  int columns = GetSnowpackColumns(buffer);
+  for(int x = 0; x < columns - 1; x++) {
+    float diff = pack->height[x] - pack->height[x + 1];
+    if(diff > SNOWPACK_MAX_SLOPE || diff < -SNOWPACK_MAX_SLOPE) {
+      float slope = (diff > 0) ? SNOWPACK_MAX_SLOPE : -SNOWPACK_MAX_SLOPE;
+      float move = 0.5f * (diff - slope);
+      pack->height[x] -= move;
+      pack->height[x + 1] += move;
+      MarkSnowpackColumns(pack, buffer, x, x + 1, tick);
+    }
+  }
+}
+
+/*
+ * Function Name: DrawSnowpack
+ * Description: Redraw the band the pack can reach, only in columns that
+ *              changed since the buffer was last drawn
+ * Parameters: pack - snowpack
+ *             buffer - framebuffer
+ *             minY - first row to draw
+ *             maxY - row past the end
+ *             backgroundColor - sky color above the surface
+ *             snowColor - pack color
+ *             tick - current frame
+ * Side Effects: Writes band pixels of changed columns between minY and maxY
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+template<typename Format>
+internal void
+DrawSnowpack(Snowpack *pack, FrameBuffer *buffer, int minY, int maxY,
+             Color backgroundColor, Color snowColor, uint32_t tick) {
+  int bandTop = Max(buffer->height - pack->bandHeight, 0);
+  minY = Max(minY, bandTop);
+  maxY = Min(maxY, buffer->height);
+  if(minY >= maxY) {
+    return;
+  }
+
+  // Buffers missing a band resize need every column
+  uint32_t age = buffer->age;
+  bool redrawAll = (age == 0) || (tick - pack->bandChangedTick <= age);
+
+  typename Format::Pixel background = Format::Pack(backgroundColor);
+  typename Format::Pixel snow = Format::Pack(snowColor);
+  int columns = GetSnowpackColumns(buffer);
+  for(int x = 0; x < columns; x++) {
+    if(!redrawAll && tick - pack->changedTick[x] > age) {
+      continue;
+    }
+
+    // Surface pixel is covered by the fraction of it below the surface
+    float surface = buffer->height - pack->height[x];
+    int surfaceRow = Min(Max(FloorFloatToInt32(surface), bandTop), buffer->height);
+    float coverage = Min(Max(surfaceRow + 1 - surface, 0.0f), 1.0f);
+
+    uint8_t *pixel = GetPixel(buffer, x, minY);
+    int y = minY;
+    for(; y < Min(surfaceRow, maxY); y++) {
+      *(typename Format::Pixel *)pixel = background;
+      pixel += buffer->pitch;
+    }
+    if(y == surfaceRow && y < maxY) {
+      *(typename Format::Pixel *)pixel = Format::Blend(background, snow, AlphaToFixed(coverage));
+      pixel += buffer->pitch;
+      y++;
+    }
+    for(; y < maxY; y++) {
+      *(typename Format::Pixel *)pixel = snow;
+      pixel += buffer->pitch;
+    }
+  }
+
+  // Columns past the pack never hold snow
+  if(columns < buffer->width) {
+    FillPixelRect<Format>(buffer, columns, minY, buffer->width, maxY, backgroundColor);
+  }
+}
@@ -0,0 +1,186 @@
+/*
+ * Filename: spatial.cpp
+ * Author: Kevin Hine
+ * Description: Uniform grid index over the particle store
+ * Date: Oct 18 2026
+ */
+
+#include "spatial.h"
+
+/*
+ * Function Name: GetSpatialCell
+ * Description: Grid coordinate of a position. Cells cover the whole plane,
+ *              off-screen particles keep their own cells
+ * Parameters: pos - position in pixels
+ * Side Effects: N/A
+ * Error Conditions: Clamped to 16 bits, far positions share the edge cells
+ * Return Value: Cell coordinate
+ */
+inline internal int
+GetSpatialCell(float pos) {
+  float cell = Max(pos * (1.0f / SPATIAL_CELL_SIZE), -32768.0f);
+  cell = Min(cell, 32767.0f);
+  int result = FloorFloatToInt32(cell);
+  return result;
+}
+
+/*
+ * Function Name: GetSpatialCellKey
+ * Description: Pack a cell's coordinates into one value
+ * Parameters: cellX - horizontal cell
+ *             cellY - vertical cell
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Result
+ */
+inline internal uint32_t
+GetSpatialCellKey(int cellX, int cellY) {
+  // x is offset rather than wrapped so keys climb with it across 0
+  uint32_t result = ((uint32_t)(uint16_t)cellY << 16) | (uint32_t)(cellX + 32768);
+  return result;
+}
+
+/*
+ * Function Name: GetSpatialBucket
+ * Description: Hash a cell to its bucket. Rows start at a hashed bucket and
+ *              run on from there, so cells side by side share cache lines
+ * Parameters: cell - cell key
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Bucket index
+ */
+inline internal uint32_t
+GetSpatialBucket(uint32_t cell) {
+  uint32_t rowStart = ((cell >> 16) * 0x9e3779b1) % SPATIAL_GRID_BUCKETS;
+  uint32_t result = (rowStart + (cell & 0xffff)) % SPATIAL_GRID_BUCKETS;
+  return result;
+}
+
+/*
+ * Function Name: RebuildSpatialGrid
+ * Description: Bucket live particles by cell with a counting sort, linear in
+ *              the particle count and allocation free
+ * Parameters: grid - spatial index
+ *             particles - particle store
+ *             count - particle store length
+ * Side Effects: Overwrites the index
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+internal void
+RebuildSpatialGrid(SpatialGrid *grid, Particle *particles, uint32_t count) {
+  Assert(count <= ArrayLength(grid->sortedParticles));
+
+  // Count, then exclusive prefix sum so bucketStart[b + 1] is the end of b
+  for(int b = 0; b <= SPATIAL_GRID_BUCKETS; b++) {
+    grid->bucketStart[b] = 0;
+  }
+  for(uint32_t i = 0; i < count; i++) {
+    Particle *p = particles + i;
+    if(p->lifetime != 0) {
+      uint32_t cell = GetSpatialCellKey(GetSpatialCell(p->x), GetSpatialCell(p->y));
+      grid->particleCell[i] = cell;
+      grid->bucketStart[GetSpatialBucket(cell) + 1]++;
+    }
+  }
+  for(int b = 0; b < SPATIAL_GRID_BUCKETS; b++) {
+    grid->bucketStart[b + 1] += grid->bucketStart[b];
+  }
+
+  // Scatter, using bucketStart as the write cursor then shifting it back
+  for(uint32_t i = 0; i < count; i++) {
+    if(particles[i].lifetime != 0) {
+      uint32_t cell = grid->particleCell[i];
+      uint32_t at = grid->bucketStart[GetSpatialBucket(cell)]++;
+      grid->sortedParticles[at] = i;
+      grid->sortedCells[at] = cell;
+    }
+  }
+  for(int b = SPATIAL_GRID_BUCKETS; b > 0; b--) {
+    grid->bucketStart[b] = grid->bucketStart[b - 1];
+  }
+  grid->bucketStart[0] = 0;
+}
+
+/*
+ * Function Name: SetSpatialQueryRow
+ * Description: Point a query at the buckets of its current row of cells.
+ *              They run on from the row's first bucket, wrapping past the
+ *              end of the table at most once
+ * Parameters: grid - spatial index
+ *             query - query cursor
+ * Side Effects: Resets the cursor's bucket range
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+inline internal void
+SetSpatialQueryRow(SpatialGrid *grid, SpatialQuery *query) {
+  uint32_t first = GetSpatialBucket(GetSpatialCellKey(query->minCellX, query->cellY));
+  uint32_t count = Min((uint32_t)(query->maxCellX - query->minCellX + 1), (uint32_t)SPATIAL_GRID_BUCKETS);
+  uint32_t end = Min(first + count, (uint32_t)SPATIAL_GRID_BUCKETS);
+  query->row = (uint16_t)query->cellY;
+  query->at = grid->bucketStart[first];
+  query->end = grid->bucketStart[end];
+  query->wrappedBuckets = first + count - end;
+}
+
+/*
+ * Function Name: BeginSpatialQuery
+ * Description: Start walking the particles in cells overlapping a rect
+ * Parameters: grid - spatial index
+ *             minX - rect min x pos
+ *             minY - rect min y pos
+ *             maxX - rect max x pos
+ *             maxY - rect max y pos
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Query cursor
+ */
+internal SpatialQuery
+BeginSpatialQuery(SpatialGrid *grid, float minX, float minY, float maxX, float maxY) {
+  SpatialQuery result;
+  result.minCellX = GetSpatialCell(minX);
+  result.maxCellX = GetSpatialCell(maxX);
+  result.maxCellY = GetSpatialCell(maxY);
+  result.cellY = GetSpatialCell(minY);
+  SetSpatialQueryRow(grid, &result);
+  return result;
+}
+
+/*
+ * Function Name: NextSpatialQuery
+ * Description: Advance a query to its next particle, skipping those of
+ *              other cells sharing its buckets
+ * Parameters: grid - spatial index
+ *             query - query cursor
+ *             particle - next particle index
+ * Side Effects: Advances the cursor
+ * Error Conditions: N/A
+ * Return Value: False once every row is exhausted
+ */
+internal bool
+NextSpatialQuery(SpatialGrid *grid, SpatialQuery *query, uint32_t *particle) {
+  for(;;) {
+    while(query->at < query->end) {
+      uint32_t at = query->at++;
+      uint32_t cell = grid->sortedCells[at];
+      int cellX = (int)(cell & 0xffff) - 32768;
+      if((cell >> 16) == query->row && cellX >= query->minCellX && cellX <= query->maxCellX) {
+        *particle = grid->sortedParticles[at];
+        return true;
+      }
+    }
+
+    if(query->wrappedBuckets) {
+      query->at = grid->bucketStart[0];
+      query->end = grid->bucketStart[query->wrappedBuckets];
+      query->wrappedBuckets = 0;
+    }
+    else if(++query->cellY > query->maxCellY) {
+      return false;
+    }
+    else {
+      SetSpatialQueryRow(grid, query);
+    }
+  }
+}
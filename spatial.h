@@ -0,0 +1,44 @@
+/*
+ * Filename: spatial.h
+ * Author: Kevin Hine
+ * Description: Uniform grid index over the particle store
+ * Date: Oct 18 2026
+ */
+
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+// Cells span the largest flake's diameter, so touching flakes are at most a
+// cell apart wherever they are
+#define SPATIAL_CELL_SIZE (2 * PARTICLE_MAX_RADIUS)
+// Cells hash into buckets that scale with the particle count rather than the
+// framebuffer. A query row of three cells scans three buckets, 3/4 of a
+// particle from other cells on average
+#define SPATIAL_GRID_BUCKETS (4 * MAX_PARTICLES)
+
+// Rebuilt every frame with a counting sort by bucket, particles in bucket b
+// are sortedParticles[bucketStart[b]] up to sortedParticles[bucketStart[b + 1]].
+// sortedCells holds each one's cell, as buckets are shared by unrelated cells
+struct SpatialGrid {
+  uint32_t bucketStart[SPATIAL_GRID_BUCKETS + 1];
+  // Cell of each live particle, indexed like the particle store
+  uint32_t particleCell[MAX_PARTICLES];
+  uint32_t sortedParticles[MAX_PARTICLES];
+  uint32_t sortedCells[MAX_PARTICLES];
+};
+
+// Walks the particles in every cell overlapping a rect, a row of cells at a
+// time. Results are candidates, callers test exact bounds
+struct SpatialQuery {
+  int minCellX;
+  int maxCellX;
+  int maxCellY;
+  int cellY;
+  uint32_t row;
+  uint32_t at;
+  uint32_t end;
+  // Buckets of the row past the end of the table, walked from bucket 0
+  uint32_t wrappedBuckets;
+};
+
+#endif /* SPATIAL_H */
@@ -0,0 +1,140 @@
+/*
+ * Filename: stats.cpp
+ * Author: Kevin Hine
+ * Description: Counters shared with external monitors
+ * Date: Oct 18 2026
+ */
+
+#include "stats.h"
+
+/*
+ * Function Name: GetStatsSlot
+ * Description: Counters owned by the calling thread
+ * Parameters: memory - system allocated storage
+ *             threadIndex - pool thread running the caller, 0 off the pool
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Slot, 0 if the platform shares no stats
+ */
+inline internal StatsSlot *
+GetStatsSlot(Memory *memory, int threadIndex) {
+  StatsSlot *result = 0;
+  if(memory->stats) {
+    result = memory->stats->slots + (threadIndex % STATS_MAX_THREADS);
+  }
+  return result;
+}
+
+/*
+ * Function Name: StatsAdd
+ * Description: Add to a shared counter
+ * Parameters: counter - slot counter
+ *             value - amount
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+inline internal void
+StatsAdd(uint64_t *counter, uint64_t value) {
+  // Ordering is left to the reader, it only needs untorn values
+  __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function Name: GetStatsBucket
+ * Description: Histogram bucket of a duration. Below 4ns buckets are exact,
+ *              above they split each octave in four, about 19% wide
+ * Parameters: nanoseconds - duration
+ * Side Effects: N/A
+ * Error Conditions: Clamps to the last bucket
+ * Return Value: Bucket index
+ */
+inline internal int
+GetStatsBucket(uint64_t nanoseconds) {
+  if(nanoseconds < 4) {
+    return (int)nanoseconds;
+  }
+
+  int octave = 63 - __builtin_clzll(nanoseconds);
+  int result = (octave - 1) * 4 + (int)((nanoseconds >> (octave - 2)) & 3);
+  if(result >= STATS_HISTOGRAM_BUCKETS) {
+    result = STATS_HISTOGRAM_BUCKETS - 1;
+  }
+  return result;
+}
+
+/*
+ * Function Name: GetStatsBucketMin
+ * Description: Shortest duration counted in a histogram bucket
+ * Parameters: bucket - bucket index
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Nanoseconds
+ */
+inline internal uint64_t
+GetStatsBucketMin(int bucket) {
+  if(bucket < 4) {
+    return bucket;
+  }
+
+  int octave = bucket / 4 + 1;
+  uint64_t result = (uint64_t)(4 + bucket % 4) << (octave - 2);
+  return result;
+}
+
+/*
+ * Function Name: BeginStatsTimer
+ * Description: Start timing a phase
+ * Parameters: memory - system allocated storage
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: Clock reading, 0 if the platform shares no stats
+ */
+inline internal uint64_t
+BeginStatsTimer(Memory *memory) {
+  uint64_t result = 0;
+  if(memory->stats && memory->getNanoseconds) {
+    result = memory->getNanoseconds();
+  }
+  return result;
+}
+
+/*
+ * Function Name: EndStatsTimer
+ * Description: Count a phase's duration in its histogram
+ * Parameters: memory - system allocated storage
+ *             slot - calling thread's counters, may be 0
+ *             phase - phase timed
+ *             start - BeginStatsTimer reading
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+inline internal void
+EndStatsTimer(Memory *memory, StatsSlot *slot, StatsPhase phase, uint64_t start) {
+  if(slot && memory->getNanoseconds) {
+    uint64_t elapsed = memory->getNanoseconds() - start;
+    StatsAdd(&slot->phaseHistogram[phase][GetStatsBucket(elapsed)], 1);
+  }
+}
+
+/*
+ * Function Name: AddFrameCounters
+ * Description: Publish a frame's simulation counts
+ * Parameters: slot - calling thread's counters, may be 0
+ *             counters - frame counts
+ * Side Effects: N/A
+ * Error Conditions: N/A
+ * Return Value: N/A
+ */
+inline internal void
+AddFrameCounters(StatsSlot *slot, FrameCounters *counters) {
+  if(slot) {
+    StatsAdd(&slot->frames, 1);
+    StatsAdd(&slot->spawns, counters->spawns);
+    StatsAdd(&slot->spawnFailures, counters->spawnFailures);
+    StatsAdd(&slot->culls, counters->culls);
+    StatsAdd(&slot->landed, counters->landed);
+    StatsAdd(&slot->merged, counters->merged);
+  }
+}
@@ -0,0 +1,63 @@
+/*
+ * Filename: stats.h
+ * Author: Kevin Hine
+ * Description: Counters shared with external monitors
+ * Date: Oct 18 2026
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+// Layout is read by other processes, bump the version with any change
+#define STATS_MAGIC 0x574f4e53 // "SNOW"
+#define STATS_VERSION 2
+
+#define STATS_MAX_THREADS 64
+// Quarter octaves of nanoseconds, see GetStatsBucket
+#define STATS_HISTOGRAM_BUCKETS 128
+
+enum StatsPhase {
+  StatsPhase_Update,
+  StatsPhase_Render,
+
+  StatsPhase_Count,
+};
+
+// Written only by the thread that owns it, with relaxed atomics so readers
+// never see torn values. A cache line apiece keeps writers from contending
+struct alignas(64) StatsSlot {
+  uint64_t frames;
+  // Changes in each scene's particle count, so summed over every slot it is
+  // the count live now. A single slot may wrap below zero
+  uint64_t liveParticles;
+  uint64_t spawns;
+  // Spawns skipped because the free list was empty
+  uint64_t spawnFailures;
+  // Flakes retired at the end of their lifetime
+  uint64_t culls;
+  uint64_t landed;
+  uint64_t merged;
+  uint64_t pixelsBlended;
+  uint64_t phaseHistogram[StatsPhase_Count][STATS_HISTOGRAM_BUCKETS];
+};
+
+struct Stats {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  uint32_t pid;
+  StatsSlot slots[STATS_MAX_THREADS];
+};
+
+// Counted in plain locals over a frame and added to a slot once
+struct FrameCounters {
+  uint32_t spawns;
+  uint32_t spawnFailures;
+  uint32_t culls;
+  uint32_t landed;
+  uint32_t merged;
+  // Particles alive at the end of the frame
+  uint32_t liveParticles;
+};
+
+#endif /* STATS_H */
@@ -15,10 +15,14 @@
 struct win32FrameBuffer {
   BITMAPINFO info;
   void *bitmap;
+  // Bytes allocated for bitmap, kept across resizes that fit
+  size_t capacity;
   int width;
   int height;
   int pitch;
   int pixelBytes;
+  // Frames since bitmap was drawn, 0 if never, see FrameBuffer::age
+  int age;
 };
 
 struct win32Dimension {
@@ -30,6 +34,7 @@ global_variable bool globalRunning;
 global_variable win32FrameBuffer globalBuffer;
 
 global_variable int64_t globalPerfCountFrequency;
+global_variable bool globalLargePages;
 
 /*
  * Function Name: Win32GetWindowDimension
@@ -52,39 +57,131 @@ Win32GetWindowDimension(HWND window) {
   return result;
 }
 
+/*
+ * Function Name: Win32EnableLargePages
+ * Description: Enable the lock memory privilege large page allocations need.
+ *              The account must be granted it in local security policy
+ * Parameters: N/A
+ * Side Effects: Adjusts process token
+ * Error Conditions: Returns false if the privilege isn't held
+ * Return Value: Success
+ */
+internal bool
+Win32EnableLargePages() {
+  HANDLE token;
+  if(!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+    return false;
+  }
+
+  TOKEN_PRIVILEGES privileges = {};
+  privileges.PrivilegeCount = 1;
+  privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+  bool result = LookupPrivilegeValue(0, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+                AdjustTokenPrivileges(token, FALSE, &privileges, 0, 0, 0) &&
+                GetLastError() == ERROR_SUCCESS;
+  CloseHandle(token);
+  return result;
+}
+
+/*
+ * Function Name: Win32Allocate
+ * Description: Allocate zeroed memory, on large pages when permitted
+ * Parameters: size - requested bytes
+ *             allocatedSize - bytes actually committed
+ * Side Effects: Commits memory
+ * Error Conditions: Returns 0 if the allocation fails
+ * Return Value: Memory
+ */
+internal void *
+Win32Allocate(size_t size, size_t *allocatedSize) {
+  SIZE_T largePageSize = globalLargePages ? GetLargePageMinimum() : 0;
+  if(largePageSize) {
+    size_t largeSize = AlignPow2(size, largePageSize);
+    void *result = VirtualAlloc(0, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if(result) {
+      *allocatedSize = largeSize;
+      return result;
+    }
+  }
+
+  *allocatedSize = size;
+  return VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+/*
+ * Function Name: Win32Reserve
+ * Description: Allocate zeroed memory whose head is touched every frame and
+ *              whose tail is headroom that may never be used. Only the head
+ *              takes large pages, which are locked in physical memory; the
+ *              tail is committed normally and faults in on first touch
+ * Parameters: size - requested bytes
+ *             usedSize - bytes at the start expected to be touched
+ *             allocatedSize - bytes actually committed
+ * Side Effects: Commits memory
+ * Error Conditions: Returns 0 if the allocation fails
+ * Return Value: Memory
+ */
+internal void *
+Win32Reserve(size_t size, size_t usedSize, size_t *allocatedSize) {
+  SIZE_T largePageSize = globalLargePages ? GetLargePageMinimum() : 0;
+  if(largePageSize) {
+    size_t largeSize = Min(AlignPow2(usedSize, largePageSize), AlignPow2(size, largePageSize));
+    uint8_t *result = (uint8_t *)VirtualAlloc(0, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                              PAGE_READWRITE);
+    if(result) {
+      // The tail only fits if nothing else took the address range after it
+      if(largeSize >= size ||
+         VirtualAlloc(result + largeSize, size - largeSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE)) {
+        *allocatedSize = Max(size, largeSize);
+        return result;
+      }
+      VirtualFree(result, 0, MEM_RELEASE);
+    }
+  }
+
+  *allocatedSize = size;
+  return VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
 /*
  * Function Name: Win32ResizeDIBSection
  * Description: Scale framebuffer to window dimension
  * Parameters: buffer - framebuffer
  *             width - bitmap width
  *             height - bitmap height
- * Side Effects: Reallocate the bitmap
+ * Side Effects: Reallocates the bitmap if it has outgrown its allocation
  * Error Conditions: N/A
  * Return Value: N/A
  */
 internal void
 Win32ResizeDIBSection(win32FrameBuffer *buffer, int width, int height) {
-  if(buffer->bitmap) {
-    VirtualFree(buffer, 0, MEM_RELEASE);
-  }
-
   buffer->width = width;
   buffer->height = height;
-  buffer->pitch = buffer->width*buffer->pixelBytes;
   buffer->pixelBytes = 4;
+  buffer->age = 0;
+  buffer->pitch = AlignPow2(buffer->width*buffer->pixelBytes, FRAMEBUFFER_ROW_ALIGNMENT);
 
-  // Negative biHeight specifies that this is a top-down image
+  // Negative biHeight specifies that this is a top-down image. Rows are padded
+  // by widening the DIB, only width columns are ever displayed
   BITMAPINFOHEADER *bmiHeader = &buffer->info.bmiHeader;
   bmiHeader->biSize = sizeof(buffer->info.bmiHeader);
-  bmiHeader->biWidth = buffer->width;
+  bmiHeader->biWidth = buffer->pitch / buffer->pixelBytes;
   bmiHeader->biHeight = -buffer->height;
   bmiHeader->biPlanes = 1;
   bmiHeader->biBitCount = 32;
   bmiHeader->biCompression = BI_RGB;
 
-  // VirtualAlloc clears to zero, so bitmap is automatically cleared to black
-  int bitmapSize = (buffer->width * buffer->height) * buffer->pixelBytes;
-  buffer->bitmap = VirtualAlloc(0, bitmapSize, MEM_COMMIT, PAGE_READWRITE);
+  // Shrinking or resizing within the allocation keeps the bitmap, the frame is
+  // fully redrawn anyway
+  size_t bitmapSize = (size_t)buffer->pitch * buffer->height;
+  if(bitmapSize > buffer->capacity) {
+    if(buffer->bitmap) {
+      VirtualFree(buffer->bitmap, 0, MEM_RELEASE);
+    }
+
+    // VirtualAlloc clears to zero, so bitmap is automatically cleared to black
+    buffer->bitmap = Win32Allocate(bitmapSize, &buffer->capacity);
+  }
 }
 
 /*
@@ -212,6 +309,9 @@ WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLine, int showC
   // Close window on crash
   SetErrorMode(SEM_FAILCRITICALERRORS | SEM_NOGPFAULTERRORBOX);
 
+  // Large pages keep full-screen passes from thrashing the TLB
+  globalLargePages = Win32EnableLargePages();
+
   // Window init
   WNDCLASS windowClass = {};
   windowClass.style = CS_OWNDC|CS_HREDRAW|CS_VREDRAW;
@@ -243,9 +343,11 @@ WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLine, int showC
   Win32ResizeDIBSection(&globalBuffer, dimension.width, dimension.height);
 
   Memory memory = {};
-  memory.size = sizeof(State); //Megabytes(1);
-  memory.storage = VirtualAlloc(0, memory.size, MEM_COMMIT, PAGE_READWRITE);
-  Assert(memory.size > 0);
+  size_t memoryAllocatedSize;
+  memory.size = SNOW_MEMORY_SIZE;
+  memory.storage = Win32Reserve(memory.size, sizeof(State), &memoryAllocatedSize);
+  Assert(memory.storage);
+  SetDefaultObstacles(&memory);
  
   // Main loop
   LARGE_INTEGER lastCounter = Win32GetWallClock();
@@ -270,10 +372,13 @@ WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLine, int showC
     buffer.height = globalBuffer.height;
     buffer.pitch = globalBuffer.pitch;
     buffer.pixelBytes = globalBuffer.pixelBytes;
+    buffer.format = PixelFormat_BGRA8888;
+    buffer.age = globalBuffer.age;
 
     // Uses the total frame time for the previous frame,
     // which is only accurate with a consistent frame-rate
     UpdateAndRender(&memory, &buffer, frameSecondsElapsed);
+    globalBuffer.age = 1;
     
     // Enforced framerate
     LARGE_INTEGER workCounter = Win32GetWallClock();